@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../libchesscat.h"
+
+// Times make/unmake with the incremental Zobrist update against recomputing the hash from scratch,
+// over every move of a perft tree. Usage: bench [depth] [FEN]
+
+double Seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+uint64_t WalkMoves(chesscat_Position *position, uint8_t depth, chesscat_PackedMove move_stack[], uint16_t max_moves, bool recompute, uint64_t *mismatches)
+{ // Generates each ply's moves into the next max_moves moves of move_stack
+    chesscat_PackedMove *moves = move_stack;
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, moves, max_moves);
+    uint64_t num_made = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, moves[i], &undo);
+        num_made++;
+        if (recompute && chesscat_compute_hash(position) != position->hash)
+        {
+            (*mismatches)++;
+        }
+        if (depth > 1)
+        {
+            num_made += WalkMoves(position, depth - 1, move_stack + max_moves, max_moves, recompute, mismatches);
+        }
+        chesscat_undo_move(position, &undo);
+    }
+    return num_made;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t depth = argc > 1 ? atoi(argv[1]) : 4;
+    chesscat_Game game;
+    if (argc > 2)
+    {
+        if (chesscat_set_game_to_FEN(&game, argv[2]) != 0)
+        {
+            printf("Invalid FEN\n");
+            return 1;
+        }
+    }
+    else
+    {
+        chesscat_set_default_game(&game);
+    }
+
+    uint16_t max_moves = chesscat_get_max_moves(&(game.position.game_rules));
+    chesscat_PackedMove *move_stack = malloc((size_t)(depth > 1 ? depth : 1) * max_moves * sizeof(chesscat_PackedMove));
+    if (move_stack == NULL)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    uint64_t mismatches = 0;
+    double start = Seconds();
+    uint64_t num_made = WalkMoves(&(game.position), depth, move_stack, max_moves, false, &mismatches);
+    double walk_time = Seconds() - start;
+
+    start = Seconds();
+    WalkMoves(&(game.position), depth, move_stack, max_moves, true, &mismatches);
+    double recompute_time = Seconds() - start - walk_time;
+    free(move_stack);
+
+    printf("Moves made: %llu\n", (unsigned long long)num_made);
+    printf("Generate, make and unmake (incremental hash): %.1f ns/move\n", walk_time * 1e9 / num_made);
+    printf("Hash recomputed from scratch: %.1f ns/move\n", recompute_time * 1e9 / num_made);
+    printf("Hash mismatches: %llu\n", (unsigned long long)mismatches);
+    return mismatches != 0;
+}
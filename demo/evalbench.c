@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../libchesscat.h"
+
+// Compares evaluations per second of the material evaluator against the network evaluator, with and without AVX2,
+// over every position of a perft tree, and checks the incrementally updated accumulators against rebuilt ones.
+// Without a weights file, a network with random weights is written to random.nnue and used.
+// Usage: evalbench [depth] [weights file] [FEN]
+
+#define RANDOM_NETWORK_FILE "random.nnue"
+
+double Seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void WriteRandomBytes(FILE *file, size_t count, int range)
+{ // Writes count int8_t values in [-range, range]
+    for (size_t i = 0; i < count; i++)
+    {
+        int8_t value = rand() % (2 * range + 1) - range;
+        fwrite(&value, 1, 1, file);
+    }
+}
+
+void WriteRandomWords(FILE *file, size_t count, size_t size, int range)
+{ // Writes count little-endian integers of size bytes in [-range, range]
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t value = rand() % (2 * range + 1) - range;
+        fwrite(&value, size, 1, file);
+    }
+}
+
+bool WriteRandomNetwork(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    uint8_t header[CHESSCAT_NNUE_HEADER_SIZE] = {0};
+    chesscat_NetworkHeader fields = {CHESSCAT_NNUE_MAGIC, CHESSCAT_NNUE_VERSION, CHESSCAT_NNUE_NUM_FEATURES, CHESSCAT_NNUE_L1, CHESSCAT_NNUE_L2, CHESSCAT_NNUE_L3};
+    memcpy(header, &fields, sizeof(fields));
+    fwrite(header, sizeof(header), 1, file);
+    srand(1);
+    WriteRandomWords(file, (size_t)CHESSCAT_NNUE_NUM_FEATURES * CHESSCAT_NNUE_L1, sizeof(int16_t), 8);
+    WriteRandomWords(file, CHESSCAT_NNUE_L1, sizeof(int16_t), 64);
+    WriteRandomBytes(file, CHESSCAT_NNUE_L2 * CHESSCAT_NNUE_L1, 16);
+    WriteRandomWords(file, CHESSCAT_NNUE_L2, sizeof(int32_t), 256);
+    WriteRandomBytes(file, CHESSCAT_NNUE_L3 * CHESSCAT_NNUE_L2, 64);
+    WriteRandomWords(file, CHESSCAT_NNUE_L3, sizeof(int32_t), 256);
+    WriteRandomBytes(file, CHESSCAT_NNUE_L3, 127);
+    WriteRandomWords(file, 1, sizeof(int32_t), 256);
+    return fclose(file) == 0;
+}
+
+int64_t EvaluateTree(chesscat_Position *position, uint8_t depth, chesscat_PackedMove move_stack[], uint16_t max_moves, bool use_network, uint64_t *num_evals)
+{ // Evaluates every position after each move, and returns the sum of the scores. Each ply's moves go in the next max_moves moves of move_stack
+    chesscat_PackedMove *moves = move_stack;
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, moves, max_moves);
+    int64_t sum = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, moves[i], &undo);
+        sum += use_network ? chesscat_evaluate_network(position) : chesscat_evaluate_material(position);
+        (*num_evals)++;
+        if (depth > 1)
+        {
+            sum += EvaluateTree(position, depth - 1, move_stack + max_moves, max_moves, use_network, num_evals);
+        }
+        chesscat_undo_move(position, &undo);
+    }
+    return sum;
+}
+
+uint64_t CheckAccumulators(chesscat_Position *position, uint8_t depth, chesscat_PackedMove move_stack[], uint16_t max_moves, chesscat_Position *scratch)
+{ // Returns the number of positions whose accumulators differ from ones rebuilt from scratch
+    chesscat_PackedMove *moves = move_stack;
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, moves, max_moves);
+    uint64_t mismatches = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, moves[i], &undo);
+        *scratch = *position;
+        chesscat_refresh_accumulators(scratch);
+        if (memcmp(scratch->accumulators, position->accumulators, sizeof(position->accumulators)) != 0)
+        {
+            mismatches++;
+        }
+        if (depth > 1)
+        {
+            mismatches += CheckAccumulators(position, depth - 1, move_stack + max_moves, max_moves, scratch);
+        }
+        chesscat_undo_move(position, &undo);
+    }
+    return mismatches;
+}
+
+void RunEvals(const char *name, chesscat_Position *position, uint8_t depth, chesscat_PackedMove move_stack[], uint16_t max_moves, bool use_network, int64_t *sum)
+{
+    uint64_t num_evals = 0;
+    double start = Seconds();
+    *sum = EvaluateTree(position, depth, move_stack, max_moves, use_network, &num_evals);
+    double elapsed = Seconds() - start;
+    printf("%-20s %llu evals in %.3f s, %.0f evals/second (including make and unmake)\n", name, (unsigned long long)num_evals, elapsed, num_evals / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t depth = argc > 1 ? atoi(argv[1]) : 4;
+    const char *weights = argc > 2 ? argv[2] : RANDOM_NETWORK_FILE;
+    chesscat_Game game;
+    if (argc > 3)
+    {
+        if (chesscat_set_game_to_FEN(&game, argv[3]) != 0)
+        {
+            printf("Invalid FEN\n");
+            return 1;
+        }
+    }
+    else
+    {
+        chesscat_set_default_game(&game);
+    }
+    if (argc <= 2 && !WriteRandomNetwork(weights))
+    {
+        printf("Could not write %s\n", weights);
+        return 1;
+    }
+    if (!chesscat_load_network(weights))
+    {
+        printf("Could not load %s\n", weights);
+        return 1;
+    }
+
+    uint16_t max_moves = chesscat_get_max_moves(&(game.position.game_rules));
+    chesscat_PackedMove *move_stack = malloc((size_t)(depth > 1 ? depth : 1) * max_moves * sizeof(chesscat_PackedMove));
+    chesscat_Position *scratch = malloc(sizeof(chesscat_Position));
+    if (move_stack == NULL || scratch == NULL)
+    {
+        printf("Out of memory\n");
+        free(move_stack);
+        free(scratch);
+        chesscat_unload_network();
+        return 1;
+    }
+
+    int64_t material_sum;
+    int64_t scalar_sum;
+    int64_t simd_sum = 0;
+    RunEvals("Material:", &(game.position), depth, move_stack, max_moves, false, &material_sum);
+    chesscat_set_network_simd(false);
+    RunEvals("Network (scalar):", &(game.position), depth, move_stack, max_moves, true, &scalar_sum);
+    bool has_simd = chesscat_set_network_simd(true);
+    if (has_simd)
+    {
+        RunEvals("Network (AVX2):", &(game.position), depth, move_stack, max_moves, true, &simd_sum);
+    }
+
+    uint64_t mismatches = CheckAccumulators(&(game.position), depth, move_stack, max_moves, scratch);
+    free(scratch);
+    free(move_stack);
+    printf("Accumulator mismatches: %llu\n", (unsigned long long)mismatches);
+    bool kernels_agree = !has_simd || simd_sum == scalar_sum;
+    printf("AVX2 and scalar scores %s\n", has_simd ? (kernels_agree ? "agree" : "DIFFER") : "not compared (no AVX2)");
+    chesscat_unload_network();
+    return mismatches != 0 || !kernels_agree;
+}
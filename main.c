@@ -3,6 +3,22 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    #define CHESSCAT_HAS_MMAP
+    #include <sys/mman.h>
+#endif
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    #define CHESSCAT_HAS_THREADS
+    #include <pthread.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__EMSCRIPTEN__)
+    #define CHESSCAT_HAS_AVX2 //AVX2 kernels are compiled in, and used if the CPU supports them
+    #include <immintrin.h>
+#endif
 
 #ifndef CHESSCAT_INCLUDE_MISC_H
     #include "misc.h"
@@ -30,1349 +46,5466 @@ bool chesscat_is_valid_move(chesscat_Move m)
     return chesscat_is_valid_square(m.from) && chesscat_is_valid_square(m.to);
 }
 
-/*   Position utility functions   */
+/*   Bitboard functions   */
 
-/*
- * chesscat_square_in_bounds
- *
- * Checks if a square is within the boundaries of the given position
- */
-bool chesscat_square_in_bounds(chesscat_Position *position, chesscat_Square square)
+uint16_t _chesscat_square_index(chesscat_Square square)
 {
-    return square.row >= 0 && square.col >= 0 && square.row < position->game_rules.board_height && square.col < position->game_rules.board_width;
+    return square.row * CHESSCAT_MAX_BOARD_SIZE + square.col;
 }
 
-bool _chesscat_square_on_promotion_rank(chesscat_Position *position, chesscat_Square square, chesscat_EColor color)
+chesscat_Square _chesscat_index_square(uint16_t index)
 {
-    switch (color)
-    {
-    case White:
-        return square.row == position->game_rules.board_height - 1;
-    case Black:
-        return square.row == 0;
-    case Green:
-        return square.col == position->game_rules.board_width - 1;
-    case Red:
-        return square.col == 0;
-    }
-    return false;
+    chesscat_Square square = {.row = index / CHESSCAT_MAX_BOARD_SIZE, .col = index % CHESSCAT_MAX_BOARD_SIZE};
+    return square;
 }
 
-bool _chesscat_position_ignores_checks(chesscat_Position *position)
+void _chesscat_bitboard_clear_all(chesscat_Bitboard *bitboard)
 {
-    if (position->game_rules.ignore_checks || position->game_rules.capture_all)
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        return true;
+        bitboard->words[i] = 0;
     }
-    uint8_t num_colors = 0;
-    if (position->color_data[White].is_in_game)
+}
+
+void _chesscat_bitboard_set(chesscat_Bitboard *bitboard, uint16_t index)
+{
+    bitboard->words[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+void _chesscat_bitboard_clear(chesscat_Bitboard *bitboard, uint16_t index)
+{
+    bitboard->words[index / 64] &= ~((uint64_t)1 << (index % 64));
+}
+
+bool _chesscat_bitboard_test(chesscat_Bitboard *bitboard, uint16_t index)
+{
+    return (bitboard->words[index / 64] >> (index % 64)) & 1;
+}
+
+bool _chesscat_bitboard_is_empty(chesscat_Bitboard *bitboard)
+{
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        num_colors++;
+        if (bitboard->words[i] != 0)
+        {
+            return false;
+        }
     }
-    if (position->color_data[Black].is_in_game)
+    return true;
+}
+
+uint16_t _chesscat_bitboard_count(chesscat_Bitboard *bitboard)
+{
+    uint16_t count = 0;
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        num_colors++;
+        count += __builtin_popcountll(bitboard->words[i]);
     }
-    if (position->color_data[Red].is_in_game)
+    return count;
+}
+
+void _chesscat_bitboard_intersect(chesscat_Bitboard *result, chesscat_Bitboard *a, chesscat_Bitboard *b)
+{
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        num_colors++;
+        result->words[i] = a->words[i] & b->words[i];
     }
-    if (position->color_data[Green].is_in_game)
+}
+
+/*
+ * _chesscat_bitboard_first
+ *
+ * Returns the lowest square index in the set, or CHESSCAT_NUM_SQUARES if the set is empty.
+ * Lower indices come first in row-major order, matching a row-by-row scan of the board.
+ */
+uint16_t _chesscat_bitboard_first(chesscat_Bitboard *bitboard)
+{
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        num_colors++;
+        if (bitboard->words[i] != 0)
+        {
+            return i * 64 + __builtin_ctzll(bitboard->words[i]);
+        }
     }
+    return CHESSCAT_NUM_SQUARES;
+}
 
-    if (num_colors > 2)
+/*
+ * _chesscat_bitboard_pop_first
+ *
+ * Removes and returns the lowest square index in the set, or CHESSCAT_NUM_SQUARES if the set is empty
+ */
+uint16_t _chesscat_bitboard_pop_first(chesscat_Bitboard *bitboard)
+{
+    for (uint8_t i = 0; i < CHESSCAT_BITBOARD_WORDS; i++)
     {
-        return true;
+        uint64_t word = bitboard->words[i];
+        if (word != 0)
+        {
+            bitboard->words[i] = word & (word - 1);
+            return i * 64 + __builtin_ctzll(word);
+        }
     }
-    return false;
+    return CHESSCAT_NUM_SQUARES;
 }
 
-void _chesscat_set_piece(chesscat_Position *position, int8_t row, int8_t col, chesscat_Piece piece)
+/*   Mailbox functions   */
+
+uint16_t _chesscat_mailbox_index(int8_t row, int8_t col)
 {
-    position->board[row][col] = piece;
+    return (row + CHESSCAT_MAILBOX_PADDING) * CHESSCAT_MAILBOX_STRIDE + col + CHESSCAT_MAILBOX_PADDING;
 }
 
-void chesscat_set_piece_at_square(chesscat_Position *position, chesscat_Square square, chesscat_Piece piece)
+/*
+ * _chesscat_mailbox_code
+ *
+ * Packs a piece into one mailbox byte: type in bits 0-2, color in bits 3-4 and royalty in bit 5.
+ * Empty squares are always CHESSCAT_MAILBOX_EMPTY
+ */
+uint8_t _chesscat_mailbox_code(chesscat_Piece piece)
 {
-    _chesscat_set_piece(position, square.row, square.col, piece);
+    if (piece.type == Empty)
+    {
+        return CHESSCAT_MAILBOX_EMPTY;
+    }
+    return piece.type | (piece.color << 3) | (piece.is_royal << 5);
 }
 
-chesscat_Piece _chesscat_get_piece(chesscat_Position *position, int8_t row, int8_t col)
+/*   Geometry functions   */
+
+/*
+ * _chesscat_pawn_direction
+ *
+ * Sets the row and column step of a forward pawn move for the given color
+ */
+void _chesscat_pawn_direction(chesscat_EColor color, int8_t *row_dist, int8_t *col_dist)
 {
-    return position->board[row][col];
+    *row_dist = 0;
+    *col_dist = 0;
+    switch (color)
+    {
+    case White:
+        *row_dist = 1;
+        break;
+    case Black:
+        *row_dist = -1;
+        break;
+    case Red:
+        *col_dist = -1;
+        break;
+    case Green:
+        *col_dist = 1;
+        break;
+    }
 }
 
-chesscat_Piece chesscat_get_piece_at_square(chesscat_Position *position, chesscat_Square square)
+// Ray directions as {row step, col step}. Diagonals come first, then straight lines
+static const int8_t _chesscat_ray_steps[8][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}, {1, 0}, {0, -1}, {-1, 0}, {0, 1}};
+static const int8_t _chesscat_knight_offsets[8][2] = {{2, -1}, {2, 1}, {1, 2}, {-1, 2}, {-2, 1}, {-2, -1}, {-1, -2}, {1, -2}};
+static const int8_t _chesscat_king_offsets[8][2] = {{1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}};
+
+/*   Piece-square tables   */
+
+static const int16_t _chesscat_piece_values[CHESSCAT_NUM_PIECE_TYPES] = {0, 100, 300, 900, 500, 300, 320}; //Centipawns by chesscat_EPieceType. Royal pieces are worth nothing
+
+int16_t _chesscat_piece_value(chesscat_Piece piece)
 {
-    return _chesscat_get_piece(position, square.row, square.col);
+    return piece.is_royal ? 0 : _chesscat_piece_values[piece.type];
 }
 
-chesscat_Square _chesscat_find_king(chesscat_Position *position, chesscat_EColor color)
+/*
+ * _chesscat_piece_square_value
+ *
+ * Returns the positional bonus in centipawns for a piece of a color on a square of a board size. Terms are scaled to
+ * the board, and measured along the color's own direction of play, so Green and Red get the same tables turned sideways:
+ * pawns gain as they advance, minor pieces and queens as they near the center, rooks on the far ranks, and kings stay home
+ */
+int16_t _chesscat_piece_square_value(chesscat_Geometry *geometry, chesscat_EColor color, chesscat_EPieceType type, int8_t row, int8_t col)
 {
-    for (uint16_t row = 0; row < position->game_rules.board_height; row++)
+    int16_t width = geometry->board_width;
+    int16_t height = geometry->board_height;
+    bool along_rows = color == White || color == Black;
+    int16_t length = along_rows ? height : width; //Squares along the color's direction of play
+    int16_t advance; //Squares from the color's home edge
+    switch (color)
     {
-        for (uint16_t col = 0; col < position->game_rules.board_width; col++)
-        {
-            chesscat_Square square = {.row = row, .col = col};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.type == King && piece.color == color)
-            {
-                return square;
-            }
-        }
+    case White:
+        advance = row;
+        break;
+    case Black:
+        advance = height - 1 - row;
+        break;
+    case Green:
+        advance = col;
+        break;
+    default:
+        advance = width - 1 - col;
+        break;
     }
-    chesscat_Square none = {.row = -1, .col = -1};
-    return none;
-}
+    int16_t max_center_distance = (width - 1) + (height - 1);
+    int16_t center_distance = abs(2 * row - (height - 1)) + abs(2 * col - (width - 1)); //In half squares
+    int16_t centrality = max_center_distance > 0 ? 100 - 100 * center_distance / max_center_distance : 100; //Percent, 100 in the center
+    int16_t progress = length > 1 ? 100 * advance / (length - 1) : 0; //Percent of the way to the far edge
 
-bool _chesscat_has_royal(chesscat_Position *position, chesscat_EColor color){
-    for (uint16_t row = 0; row < position->game_rules.board_height; row++)
+    switch (type)
     {
-        for (uint16_t col = 0; col < position->game_rules.board_width; col++)
-        {
-            chesscat_Square square = {.row = row, .col = col};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.is_royal && piece.color == color)
-            {
-                return true;
-            }
-        }
+    case Pawn:
+        return progress * 40 / 100 + centrality * 10 / 100;
+    case Knight:
+        return centrality * 30 / 100 - 15;
+    case Bishop:
+        return centrality * 20 / 100 - 10;
+    case Rook:
+        return progress * 10 / 100;
+    case Queen:
+        return centrality * 10 / 100 - 5;
+    case King:
+        return -progress * 30 / 100;
+    default:
+        return 0;
     }
-    return false;
 }
 
-uint16_t _chesscat_count_pieces(chesscat_Position *position, chesscat_EColor color){
-    uint16_t count = 0;
-    for (uint16_t row = 0; row < position->game_rules.board_height; row++)
+/*
+ * _chesscat_build_piece_square_tables
+ *
+ * Fills a geometry's piece-square tables for every color and piece type. Squares off the board are left at 0
+ */
+void _chesscat_build_piece_square_tables(chesscat_Geometry *geometry)
+{
+    memset(geometry->piece_squares, 0, sizeof(geometry->piece_squares));
+    for (int8_t row = 0; row < geometry->board_height; row++)
     {
-        for (uint16_t col = 0; col < position->game_rules.board_width; col++)
+        for (int8_t col = 0; col < geometry->board_width; col++)
         {
-            chesscat_Square square = {.row = row, .col = col};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.color == color && piece.type != Empty)
+            for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
             {
-                count++;
+                for (uint8_t type = Pawn; type < CHESSCAT_NUM_PIECE_TYPES; type++)
+                {
+                    geometry->piece_squares[color][type][row * CHESSCAT_MAX_BOARD_SIZE + col] = _chesscat_piece_square_value(geometry, color, type, row, col);
+                }
             }
         }
     }
-    return count;
 }
 
-chesscat_Square _chesscat_find_lower_rook(chesscat_Position *position, chesscat_EColor color)
-{ // Finds lower-coordinate rook on the specified color's king's rank
+static chesscat_Geometry *_chesscat_geometries[CHESSCAT_MAX_BOARD_SIZE + 1][CHESSCAT_MAX_BOARD_SIZE + 1]; //Built on first use, never freed
+
+bool _chesscat_geometry_in_bounds(chesscat_Geometry *geometry, int8_t row, int8_t col)
+{
+    return row >= 0 && col >= 0 && row < geometry->board_height && col < geometry->board_width;
+}
+
+void _chesscat_build_geometry(chesscat_Geometry *geometry, uint8_t board_width, uint8_t board_height)
+{
     chesscat_Square none = {.row = -1, .col = -1};
-    if (color == White || color == Black)
+    geometry->board_width = board_width;
+    geometry->board_height = board_height;
+    for (int8_t row = 0; row < board_height; row++)
     {
-        chesscat_Square king_square = _chesscat_find_king(position, color);
-        if (!chesscat_is_valid_square(king_square))
-        {
-            return none;
-        }
-        for (int8_t i = king_square.col - 1; i >= 0; i--)
+        for (int8_t col = 0; col < board_width; col++)
         {
-            chesscat_Square square = {.row = king_square.row, .col = i};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.type == Rook && piece.color == color)
+            uint16_t index = row * CHESSCAT_MAX_BOARD_SIZE + col;
+
+            geometry->num_knight_targets[index] = 0;
+            geometry->num_king_targets[index] = 0;
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                chesscat_Square knight_target = {.row = row + _chesscat_knight_offsets[i][0], .col = col + _chesscat_knight_offsets[i][1]};
+                if (_chesscat_geometry_in_bounds(geometry, knight_target.row, knight_target.col))
+                {
+                    geometry->knight_targets[index][geometry->num_knight_targets[index]++] = knight_target;
+                }
+                chesscat_Square king_target = {.row = row + _chesscat_king_offsets[i][0], .col = col + _chesscat_king_offsets[i][1]};
+                if (_chesscat_geometry_in_bounds(geometry, king_target.row, king_target.col))
+                {
+                    geometry->king_targets[index][geometry->num_king_targets[index]++] = king_target;
+                }
+                uint8_t length = 0;
+                while (_chesscat_geometry_in_bounds(geometry, row + _chesscat_ray_steps[i][0] * (length + 1), col + _chesscat_ray_steps[i][1] * (length + 1)))
+                {
+                    length++;
+                }
+                geometry->ray_lengths[index][i] = length;
+            }
+
+            for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
             {
-                return square;
+                int8_t row_dist;
+                int8_t col_dist;
+                _chesscat_pawn_direction(color, &row_dist, &col_dist);
+
+                geometry->pawn_push[color][index] = none;
+                geometry->pawn_double_push[color][index] = none;
+                geometry->num_pawn_captures[color][index] = 0;
+                geometry->num_pawn_attackers[color][index] = 0;
+                geometry->num_pawn_sideways[color][index] = 0;
+                switch (color)
+                {
+                case White:
+                    geometry->pawn_on_start_rank[color][index] = row <= 1;
+                    break;
+                case Black:
+                    geometry->pawn_on_start_rank[color][index] = row >= board_height - 2;
+                    break;
+                case Green:
+                    geometry->pawn_on_start_rank[color][index] = col <= 1;
+                    break;
+                case Red:
+                    geometry->pawn_on_start_rank[color][index] = col >= board_width - 2;
+                    break;
+                }
+
+                chesscat_Square sideways[2] = {{.row = row - col_dist, .col = col - row_dist}, {.row = row + col_dist, .col = col + row_dist}};
+                for (uint8_t i = 0; i < 2; i++)
+                {
+                    if (_chesscat_geometry_in_bounds(geometry, sideways[i].row, sideways[i].col))
+                    {
+                        geometry->pawn_sideways[color][index][geometry->num_pawn_sideways[color][index]++] = sideways[i];
+                    }
+                }
+
+                chesscat_Square push = {.row = row + row_dist, .col = col + col_dist};
+                if (!_chesscat_geometry_in_bounds(geometry, push.row, push.col))
+                {
+                    continue;
+                }
+                geometry->pawn_push[color][index] = push;
+                chesscat_Square double_push = {.row = row + row_dist * 2, .col = col + col_dist * 2};
+                if (_chesscat_geometry_in_bounds(geometry, double_push.row, double_push.col))
+                {
+                    geometry->pawn_double_push[color][index] = double_push;
+                }
+                chesscat_Square captures[2] = {{.row = push.row - col_dist, .col = push.col - row_dist}, {.row = push.row + col_dist, .col = push.col + row_dist}};
+                for (uint8_t i = 0; i < 2; i++)
+                {
+                    if (_chesscat_geometry_in_bounds(geometry, captures[i].row, captures[i].col))
+                    {
+                        geometry->pawn_captures[color][index][geometry->num_pawn_captures[color][index]++] = captures[i];
+                    }
+                }
             }
         }
     }
-    if (color == Green || color == Red)
+
+    // Pawn attackers are the reverse of pawn captures, so fill them once all captures are known
+    for (uint16_t index = 0; index < CHESSCAT_NUM_SQUARES; index++)
     {
-        chesscat_Square king_square = _chesscat_find_king(position, color);
-        if (!chesscat_is_valid_square(king_square))
+        chesscat_Square square = _chesscat_index_square(index);
+        if (!_chesscat_geometry_in_bounds(geometry, square.row, square.col))
         {
-            return none;
+            continue;
         }
-        for (int8_t i = king_square.row - 1; i >= 0; i--)
+        for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
         {
-            chesscat_Square square = {.row = i, .col = king_square.col};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.type == Rook && piece.color == color)
+            for (uint8_t i = 0; i < geometry->num_pawn_captures[color][index]; i++)
             {
-                return square;
+                uint16_t target = _chesscat_square_index(geometry->pawn_captures[color][index][i]);
+                geometry->pawn_attackers[color][target][geometry->num_pawn_attackers[color][target]++] = square;
             }
         }
     }
-    return none;
+    _chesscat_build_piece_square_tables(geometry);
 }
 
-chesscat_Square _chesscat_find_upper_rook(chesscat_Position *position, chesscat_EColor color)
+/*
+ * chesscat_get_geometry
+ *
+ * Returns the move tables for a board size, building them the first time that size is used.
+ * Building is not thread-safe: set up games (which builds their tables) before sharing positions between threads.
+ * Returns NULL if the size is invalid or the tables cannot be allocated
+ */
+chesscat_Geometry *chesscat_get_geometry(uint8_t board_width, uint8_t board_height)
 {
-    chesscat_Square none = {.row = -1, .col = -1};
-    if (color == White || color == Black)
+    if (board_width == 0 || board_height == 0 || board_width > CHESSCAT_MAX_BOARD_SIZE || board_height > CHESSCAT_MAX_BOARD_SIZE)
+    {
+        return NULL;
+    }
+    chesscat_Geometry *geometry = _chesscat_geometries[board_height][board_width];
+    if (geometry == NULL)
     {
-        chesscat_Square king_square = _chesscat_find_king(position, color);
-        if (!chesscat_is_valid_square(king_square))
+        geometry = malloc(sizeof(chesscat_Geometry));
+        if (geometry == NULL)
         {
-            return none;
+            return NULL;
         }
-        for (uint16_t i = king_square.col + 1; i < position->game_rules.board_width; i++)
+        _chesscat_build_geometry(geometry, board_width, board_height);
+        _chesscat_geometries[board_height][board_width] = geometry;
+    }
+    return geometry;
+}
+
+chesscat_Geometry *_chesscat_position_geometry(chesscat_Position *position)
+{
+    chesscat_Geometry *geometry = _chesscat_geometries[position->game_rules.board_height][position->game_rules.board_width];
+    if (geometry != NULL)
+    {
+        return geometry;
+    }
+    return chesscat_get_geometry(position->game_rules.board_width, position->game_rules.board_height);
+}
+
+/*   Hashing functions   */
+
+static _chesscat_ZobristKeys _chesscat_zobrist_keys;
+static bool _chesscat_zobrist_keys_ready = false;
+
+/*
+ * _chesscat_zobrist_random
+ *
+ * Returns the next number of a splitmix64 sequence, advancing its state
+ */
+uint64_t _chesscat_zobrist_random(uint64_t *state)
+{
+    *state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = *state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/*
+ * _chesscat_init_zobrist_keys
+ *
+ * Fills the Zobrist keys the first time it is called. Like chesscat_get_geometry this is not thread-safe,
+ * but setting up any game fills them
+ */
+void _chesscat_init_zobrist_keys(void)
+{
+    if (_chesscat_zobrist_keys_ready)
+    {
+        return;
+    }
+    _chesscat_ZobristKeys *keys = &_chesscat_zobrist_keys;
+    uint64_t state = 0x4368657373436174ull; //"ChessCat"
+    for (uint16_t index = 0; index < CHESSCAT_NUM_SQUARES; index++)
+    {
+        for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
         {
-            chesscat_Square square = {.row = king_square.row, .col = i};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.type == Rook && piece.color == color)
+            for (uint8_t type = Pawn; type < CHESSCAT_NUM_PIECE_TYPES; type++)
             {
-                return square;
+                keys->pieces[index][color][type] = _chesscat_zobrist_random(&state);
             }
         }
+        keys->royal[index] = _chesscat_zobrist_random(&state);
+        keys->passant[index] = _chesscat_zobrist_random(&state);
     }
-    if (color == Green || color == Red)
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
     {
-        chesscat_Square king_square = _chesscat_find_king(position, color);
-        if (!chesscat_is_valid_square(king_square))
+        keys->to_move[color] = _chesscat_zobrist_random(&state);
+        for (uint8_t castle_state = 0; castle_state < CHESSCAT_NUM_CASTLE_STATES; castle_state++)
         {
-            return none;
+            keys->castling[color][castle_state] = _chesscat_zobrist_random(&state);
         }
-        for (uint16_t i = king_square.row + 1; i < position->game_rules.board_height; i++)
+    }
+    for (uint8_t rule = 0; rule < CHESSCAT_NUM_HASHED_RULES; rule++)
+    {
+        keys->rules[rule] = _chesscat_zobrist_random(&state);
+    }
+    for (uint8_t size = 0; size <= CHESSCAT_MAX_BOARD_SIZE; size++)
+    {
+        keys->board_width[size] = _chesscat_zobrist_random(&state);
+        keys->board_height[size] = _chesscat_zobrist_random(&state);
+    }
+    for (uint16_t depth = 0; depth < CHESSCAT_NUM_PERFT_DEPTHS; depth++)
+    {
+        keys->perft_depth[depth] = _chesscat_zobrist_random(&state);
+    }
+    _chesscat_zobrist_keys_ready = true;
+}
+
+uint64_t _chesscat_piece_key(chesscat_Piece piece, uint16_t index)
+{
+    uint64_t key = _chesscat_zobrist_keys.pieces[index][piece.color][piece.type];
+    if (piece.is_royal && piece.type != Empty)
+    {
+        key ^= _chesscat_zobrist_keys.royal[index];
+    }
+    return key;
+}
+
+/*
+ * _chesscat_castling_key
+ *
+ * Returns the hash of every color's castling flags. Colors out of the game hash to nothing
+ */
+uint64_t _chesscat_castling_key(chesscat_Position *position)
+{
+    uint64_t key = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        _chesscat_ColorData *color_data = &(position->color_data[color]);
+        if (color_data->is_in_game)
         {
-            chesscat_Square square = {.row = i, .col = king_square.col};
-            chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
-            if (piece.type == Rook && piece.color == color)
-            {
-                return square;
-            }
+            uint8_t castle_state = color_data->has_king_moved | (color_data->has_lower_rook_moved << 1) | (color_data->has_upper_rook_moved << 2);
+            key ^= _chesscat_zobrist_keys.castling[color][castle_state];
         }
     }
-    return none;
+    return key;
 }
 
-void _chesscat_set_next_to_play(chesscat_Position *position)
+uint64_t _chesscat_passant_key(chesscat_Position *position)
 {
-    if (position->color_data[White].is_in_game == false &&
-        position->color_data[Black].is_in_game == false &&
-        position->color_data[Green].is_in_game == false &&
-        position->color_data[Red].is_in_game == false)
+    if (!chesscat_is_valid_square(position->passantable_square))
     {
-        return;
+        return 0;
     }
-    switch (position->to_move)
-    {
-    case White:
-        position->to_move = Red;
-        break;
-    case Red:
-        position->to_move = Black;
+    return _chesscat_zobrist_keys.passant[position->passantable_square.row * CHESSCAT_MAX_BOARD_SIZE + position->passantable_square.col];
+}
+
+/*
+ * _chesscat_rules_key
+ *
+ * Returns the hash of the board size and the rules that change which moves are legal. Engine options are not hashed
+ */
+uint64_t _chesscat_rules_key(chesscat_GameRules *rules)
+{
+    bool hashed_rules[CHESSCAT_NUM_HASHED_RULES] = {
+        rules->ignore_checks,
+        rules->capture_own,
+        rules->sideways_pawns,
+        rules->kangaroo_pawns,
+        rules->torpedo_pawns,
+        rules->capture_all,
+        rules->allow_castle,
+        rules->allow_passant};
+    uint64_t key = _chesscat_zobrist_keys.board_width[rules->board_width] ^ _chesscat_zobrist_keys.board_height[rules->board_height];
+    for (uint8_t rule = 0; rule < CHESSCAT_NUM_HASHED_RULES; rule++)
+    {
+        if (hashed_rules[rule])
+        {
+            key ^= _chesscat_zobrist_keys.rules[rule];
+        }
+    }
+    return key;
+}
+
+/*
+ * chesscat_compute_hash
+ *
+ * Computes a position's Zobrist hash from scratch. Moves keep position->hash up to date, so this is only needed
+ * to check it, or to reset it after editing a position's rules or color data by hand
+ */
+uint64_t chesscat_compute_hash(chesscat_Position *position)
+{
+    _chesscat_init_zobrist_keys();
+    uint64_t hash = _chesscat_rules_key(&(position->game_rules));
+    hash ^= _chesscat_zobrist_keys.to_move[position->to_move];
+    hash ^= _chesscat_castling_key(position);
+    hash ^= _chesscat_passant_key(position);
+    for (uint8_t row = 0; row < position->game_rules.board_height; row++)
+    {
+        for (uint8_t col = 0; col < position->game_rules.board_width; col++)
+        {
+            hash ^= _chesscat_piece_key(position->board[row][col], row * CHESSCAT_MAX_BOARD_SIZE + col);
+        }
+    }
+    return hash;
+}
+
+/*
+ * chesscat_compute_pawn_hash
+ *
+ * Computes a position's pawn hash from scratch: the Zobrist keys of its pawns alone. Board writes keep position->pawn_hash
+ * up to date, so this is only needed to check it
+ */
+uint64_t chesscat_compute_pawn_hash(chesscat_Position *position)
+{
+    _chesscat_init_zobrist_keys();
+    uint64_t hash = 0;
+    for (uint8_t row = 0; row < position->game_rules.board_height; row++)
+    {
+        for (uint8_t col = 0; col < position->game_rules.board_width; col++)
+        {
+            if (position->board[row][col].type == Pawn)
+            {
+                hash ^= _chesscat_piece_key(position->board[row][col], row * CHESSCAT_MAX_BOARD_SIZE + col);
+            }
+        }
+    }
+    return hash;
+}
+
+/*   Network accumulator functions   */
+
+static _chesscat_Network _chesscat_network; //Zeroed, so no network is loaded until chesscat_load_network
+static uint32_t _chesscat_last_network_id = 0;
+static bool _chesscat_use_avx2 = false;
+
+static const uint8_t _chesscat_seats[CHESSCAT_NUM_COLORS] = {0, 2, 1, 3}; //Seat of each chesscat_EColor around the board, clockwise from White
+
+/*
+ * _chesscat_network_feature
+ *
+ * Returns the network input index of a piece on a square as seen by the perspective color. The board is turned so that
+ * the perspective color's home edge is row 0, and colors are numbered by seat clockwise from it, so every color sees
+ * the board the same way
+ */
+uint16_t _chesscat_network_feature(chesscat_Position *position, chesscat_EColor perspective, chesscat_Piece piece, uint16_t index)
+{
+    int16_t width = position->game_rules.board_width;
+    int16_t height = position->game_rules.board_height;
+    int16_t row = index / CHESSCAT_MAX_BOARD_SIZE;
+    int16_t col = index % CHESSCAT_MAX_BOARD_SIZE;
+    int16_t turned_row;
+    int16_t turned_col;
+    switch (perspective)
+    {
+    case White:
+        turned_row = row;
+        turned_col = col;
         break;
     case Black:
-        position->to_move = Green;
+        turned_row = height - 1 - row;
+        turned_col = width - 1 - col;
+        break;
+    case Green:
+        turned_row = col;
+        turned_col = height - 1 - row;
         break;
     default:
-        position->to_move = White;
+        turned_row = width - 1 - col;
+        turned_col = row;
         break;
     }
-    uint8_t i = 0;
-    while (
-        (
-            !(position->color_data[position->to_move].is_in_game) || (
-                !_chesscat_has_royal(position, position->to_move) && !(position->game_rules.capture_all)
-            )
-        ) &&
-        i < CHESSCAT_NUM_COLORS)
+    uint8_t relative_color = (_chesscat_seats[piece.color] - _chesscat_seats[perspective]) & (CHESSCAT_NUM_COLORS - 1);
+    return (relative_color * (CHESSCAT_NUM_PIECE_TYPES - 1) + piece.type - 1) * CHESSCAT_NUM_SQUARES + turned_row * CHESSCAT_MAX_BOARD_SIZE + turned_col;
+}
+
+#ifdef CHESSCAT_HAS_AVX2
+__attribute__((target("avx2")))
+void _chesscat_accumulator_update_avx2(int16_t accumulator[], const int16_t *added, const int16_t *removed)
+{
+    for (uint16_t i = 0; i < CHESSCAT_NNUE_L1; i += 16)
     {
-        i++;
-        switch (position->to_move)
+        __m256i sum = _mm256_loadu_si256((const __m256i *)(accumulator + i));
+        if (added != NULL)
         {
-        case White:
-            position->to_move = Red;
-            break;
-        case Red:
-            position->to_move = Black;
-            break;
-        case Black:
-            position->to_move = Green;
-            break;
-        default:
-            position->to_move = White;
-            break;
+            sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i *)(added + i)));
         }
+        if (removed != NULL)
+        {
+            sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i *)(removed + i)));
+        }
+        _mm256_storeu_si256((__m256i *)(accumulator + i), sum);
     }
 }
+#endif
 
-_chesscat_EMoveCasleType _chesscat_move_castles(chesscat_Position *position, chesscat_Move move)
+/*
+ * _chesscat_accumulator_update
+ *
+ * Adds one feature's weights to an accumulator and subtracts another's. Either may be NULL
+ */
+void _chesscat_accumulator_update(int16_t accumulator[], const int16_t *added, const int16_t *removed)
 {
-    int8_t coldist = move.to.col - move.from.col;
-    int8_t rowdist = move.to.row - move.from.row;
-
-    chesscat_Piece piece = chesscat_get_piece_at_square(position, move.from);
-    if (piece.type == King && piece.is_royal && (abs(rowdist) > 1 || abs(coldist > 1)))
+#ifdef CHESSCAT_HAS_AVX2
+    if (_chesscat_use_avx2)
     {
-        if (rowdist > 0 || coldist > 0)
+        _chesscat_accumulator_update_avx2(accumulator, added, removed);
+        return;
+    }
+#endif
+    if (added != NULL)
+    {
+        for (uint16_t i = 0; i < CHESSCAT_NNUE_L1; i++)
         {
-            return UpperCastle;
+            accumulator[i] += added[i];
         }
-        if (rowdist < 0 || coldist < 0)
+    }
+    if (removed != NULL)
+    {
+        for (uint16_t i = 0; i < CHESSCAT_NNUE_L1; i++)
         {
-            return LowerCastle;
+            accumulator[i] -= removed[i];
         }
     }
-    return NotCastle;
 }
 
-bool _chesscat_color_can_capture_piece(chesscat_Position *position, chesscat_EColor color, chesscat_Piece piece)
+const int16_t *_chesscat_feature_weights(chesscat_Position *position, chesscat_EColor perspective, chesscat_Piece piece, uint16_t index)
 {
-    // NOTE: Position is used here because gamerules may change what colors can be captured
-    if(piece.type != Empty){
-        if(piece.color == color){
-            if(!(position->game_rules.capture_own)){
-                return false;
-            }
-            if(piece.type == King){
-                return false;
-            }
-        }
+    if (piece.type == Empty)
+    {
+        return NULL;
     }
-    return true;
+    return _chesscat_network.feature_weights + (size_t)_chesscat_network_feature(position, perspective, piece, index) * CHESSCAT_NNUE_L1;
 }
 
-void _chesscat_add_move_to_buf(chesscat_Move move, chesscat_Move *moves_buf[], uint16_t *num_moves)
+/*
+ * _chesscat_network_update
+ *
+ * Updates a position's accumulators for a square going from old to piece. Does nothing unless the accumulators are
+ * current for the loaded network
+ */
+void _chesscat_network_update(chesscat_Position *position, uint16_t index, chesscat_Piece old, chesscat_Piece piece)
 {
-    if (*moves_buf != NULL)
+    if (position->network_id == 0 || position->network_id != _chesscat_network.id || (old.type == Empty && piece.type == Empty))
     {
-        (*moves_buf)[*num_moves] = move;
+        return;
+    }
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        _chesscat_accumulator_update(position->accumulators[color], _chesscat_feature_weights(position, color, piece, index), _chesscat_feature_weights(position, color, old, index));
     }
-    (*num_moves)++;
 }
 
 /*
- * chesscat_get_all_possible_moves
+ * chesscat_refresh_accumulators
  *
- * Writes all possible (not necessarily legal) moves from the given square for the current color to play to moves_buf
+ * Builds a position's accumulators from scratch for the loaded network. Board writes keep them current afterwards,
+ * until the board is cleared or another network is loaded. Returns false if no network is loaded
  */
-
-uint16_t chesscat_get_possible_moves_from(chesscat_Position *position, chesscat_Square square, chesscat_Move moves_buf[])
+bool chesscat_refresh_accumulators(chesscat_Position *position)
 {
+    position->network_id = 0;
+    if (_chesscat_network.id == 0)
+    {
+        return false;
+    }
+    for (uint8_t perspective = 0; perspective < CHESSCAT_NUM_COLORS; perspective++)
+    {
+        memcpy(position->accumulators[perspective], _chesscat_network.feature_biases, sizeof(position->accumulators[perspective]));
+        for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+        {
+            for (uint16_t i = 0; i < position->piece_count[color]; i++)
+            {
+                uint16_t index = position->piece_list[color][i];
+                chesscat_Piece piece = position->board[index / CHESSCAT_MAX_BOARD_SIZE][index % CHESSCAT_MAX_BOARD_SIZE];
+                _chesscat_accumulator_update(position->accumulators[perspective], _chesscat_feature_weights(position, perspective, piece, index), NULL);
+            }
+        }
+    }
+    position->network_id = _chesscat_network.id;
+    return true;
+}
 
-    bool moves_like_bishop = false;
-    bool moves_like_rook = false;
-    bool moves_like_knight = false;
-    bool moves_like_king = false;
-    bool moves_like_pawn = false;
+/*   Position utility functions   */
 
-    chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
+/*
+ * chesscat_square_in_bounds
+ *
+ * Checks if a square is within the boundaries of the given position
+ */
+bool chesscat_square_in_bounds(chesscat_Position *position, chesscat_Square square)
+{
+    return square.row >= 0 && square.col >= 0 && square.row < position->game_rules.board_height && square.col < position->game_rules.board_width;
+}
 
-    if (piece.color != position->to_move || piece.type == Empty)
+bool _chesscat_square_on_promotion_rank(chesscat_Position *position, chesscat_Square square, chesscat_EColor color)
+{
+    switch (color)
     {
-        return 0;
+    case White:
+        return square.row == position->game_rules.board_height - 1;
+    case Black:
+        return square.row == 0;
+    case Green:
+        return square.col == position->game_rules.board_width - 1;
+    case Red:
+        return square.col == 0;
     }
+    return false;
+}
 
-    uint16_t num_moves = 0;
-
-    switch (piece.type)
+bool _chesscat_position_ignores_checks(chesscat_Position *position)
+{
+    if (position->game_rules.ignore_checks || position->game_rules.capture_all)
     {
-    case Pawn:
-        moves_like_pawn = true;
-        break;
-    case King:
-        moves_like_king = true;
-        break;
-    case Queen:
-        moves_like_bishop = true;
-        moves_like_rook = true;
-        break;
-    case Rook:
-        moves_like_rook = true;
-        break;
-    case Knight:
-        moves_like_knight = true;
-        break;
-    case Bishop:
-        moves_like_bishop = true;
-        break;
-    default:
-        break;
+        return true;
+    }
+    uint8_t num_colors = 0;
+    if (position->color_data[White].is_in_game)
+    {
+        num_colors++;
+    }
+    if (position->color_data[Black].is_in_game)
+    {
+        num_colors++;
+    }
+    if (position->color_data[Red].is_in_game)
+    {
+        num_colors++;
+    }
+    if (position->color_data[Green].is_in_game)
+    {
+        num_colors++;
     }
 
-
-    //TODO: Swap these over to use _chesscat_add_move_to_buf()
-    if (moves_like_king)
+    if (num_colors > 2)
     {
-        for (int8_t rowto = square.row - 1; rowto <= square.row + 1; rowto++)
-        {
-            if (rowto < 0 || rowto >= position->game_rules.board_height)
-            {
-                continue;
-            }
-            for (int8_t colto = square.col - 1; colto <= square.col + 1; colto++)
-            {
+        return true;
+    }
+    return false;
+}
 
-                if (colto < 0 || colto >= position->game_rules.board_height)
-                {
-                    continue;
-                }
-                if (colto == square.col && rowto == square.row)
-                {
-                    continue;
-                }
+void _chesscat_piece_list_add(chesscat_Position *position, chesscat_EColor color, uint16_t index)
+{
+    position->piece_list_index[index] = position->piece_count[color];
+    position->piece_list[color][position->piece_count[color]] = index;
+    position->piece_count[color]++;
+}
 
-                chesscat_Piece target_piece = _chesscat_get_piece(position, rowto, colto);
-                if (!_chesscat_color_can_capture_piece(position, piece.color, target_piece))
-                {
-                    continue;
-                }
+void _chesscat_piece_list_remove(chesscat_Position *position, chesscat_EColor color, uint16_t index)
+{ // Moves the last entry into the removed entry's place
+    position->piece_count[color]--;
+    uint16_t last = position->piece_list[color][position->piece_count[color]];
+    uint16_t slot = position->piece_list_index[index];
+    position->piece_list[color][slot] = last;
+    position->piece_list_index[last] = slot;
+}
 
-                chesscat_Square tosquare = {.col = colto, .row = rowto};
-                chesscat_Move move = {.from = square, .to = tosquare};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-            }
+void _chesscat_set_piece(chesscat_Position *position, int8_t row, int8_t col, chesscat_Piece piece)
+{
+    // All board writes go through here so that the bitboards and piece lists stay in sync with the board
+    uint16_t index = row * CHESSCAT_MAX_BOARD_SIZE + col;
+    chesscat_Piece old = position->board[row][col];
+    position->board[row][col] = piece;
+    position->hash ^= _chesscat_piece_key(old, index) ^ _chesscat_piece_key(piece, index);
+    if (old.type == Pawn)
+    {
+        position->pawn_hash ^= _chesscat_piece_key(old, index);
+    }
+    if (piece.type == Pawn)
+    {
+        position->pawn_hash ^= _chesscat_piece_key(piece, index);
+    }
+    chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+    position->mailbox[_chesscat_mailbox_index(row, col)] = _chesscat_mailbox_code(piece);
+    _chesscat_network_update(position, index, old, piece);
+    if (old.type != Empty)
+    {
+        position->material[old.color] -= _chesscat_piece_value(old);
+        if (geometry != NULL)
+        {
+            position->piece_squares[old.color] -= geometry->piece_squares[old.color][old.type][index];
         }
-        if (position->game_rules.allow_castle && piece.type == King && piece.is_royal && !position->color_data[piece.color].has_king_moved)
+        _chesscat_bitboard_clear(&(position->occupied), index);
+        _chesscat_bitboard_clear(&(position->color_occupancy[old.color]), index);
+        _chesscat_bitboard_clear(&(position->type_occupancy[old.type]), index);
+        _chesscat_bitboard_clear(&(position->royal_occupancy), index);
+        _chesscat_piece_list_remove(position, old.color, index);
+        if (old.is_royal)
         {
-            //NOTE: Maybe make this its own function?
-            if (!position->color_data[piece.color].has_lower_rook_moved)
+            position->royal_count[old.color]--;
+        }
+        if (old.type == King && position->color_data[old.color].king_square == index)
+        { // Fall back to any other king of the same color
+            position->color_data[old.color].king_square = CHESSCAT_NUM_SQUARES;
+            for (uint16_t i = 0; i < position->piece_count[old.color]; i++)
             {
-                chesscat_Square lower_rook = _chesscat_find_lower_rook(position, piece.color);
-                int8_t coldist = abs(square.col - lower_rook.col);
-                int8_t rowdist = abs(square.row - lower_rook.row);
-                if (chesscat_is_valid_square(lower_rook) && (coldist > 1 || rowdist > 1))
+                uint16_t other = position->piece_list[old.color][i];
+                chesscat_Piece other_piece = position->board[other / CHESSCAT_MAX_BOARD_SIZE][other % CHESSCAT_MAX_BOARD_SIZE];
+                if (other_piece.type == King)
                 {
-                    if (piece.color == White || piece.color == Black)
-                    {
-                        bool is_blocked = false;
-                        for (int8_t col = lower_rook.col + 1; col < square.col; col++)
-                        {
-                            chesscat_Square checking = {.col = col, .row = square.row};
-                            if (chesscat_get_piece_at_square(position, checking).type != Empty)
-                            {
-                                is_blocked = true;
-                                break;
-                            }
-                        }
-                        if (!is_blocked)
-                        {
-                            chesscat_Square tosquare = {.col = square.col - 2, .row = square.row};
-                            chesscat_Move move = {.from = square, .to = tosquare};
-                            _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-                        }
-                    }
-                    else
-                    {
-                        bool is_blocked = false;
-                        for (int8_t row = lower_rook.row + 1; row < square.col; row++)
-                        {
-                            chesscat_Square checking = {.col = square.col, .row = row};
-                            if (chesscat_get_piece_at_square(position, checking).type != Empty)
-                            {
-                                is_blocked = true;
-                                break;
-                            }
-                        }
-                        if (!is_blocked)
-                        {
-                            chesscat_Square tosquare = {.col = square.col, .row = square.row - 2};
-
-                            chesscat_Move move = {.from = square, .to = tosquare};
-                            _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-                        }
-                    }
+                    position->color_data[old.color].king_square = other;
+                    break;
                 }
             }
-            if (!position->color_data[piece.color].has_upper_rook_moved)
-            {
-                chesscat_Square upper_rook = _chesscat_find_upper_rook(position, piece.color);
-                int8_t coldist = abs(square.col - upper_rook.col);
-                int8_t rowdist = abs(square.row - upper_rook.row);
-                if (chesscat_is_valid_square(upper_rook) && (coldist > 1 || rowdist > 1))
-                {
-                    if (piece.color == White || piece.color == Black)
-                    {
-                        bool is_blocked = false;
-                        for (int8_t col = upper_rook.col - 1; col > square.col; col--)
-                        {
-                            chesscat_Square checking = {.col = col, .row = square.row};
-                            if (chesscat_get_piece_at_square(position, checking).type != Empty)
-                            {
-                                is_blocked = true;
-                                break;
-                            }
-                        }
-                        if (!is_blocked)
-                        {
-                            chesscat_Square tosquare = {.col = square.col + 2, .row = square.row};
-
-                            chesscat_Move move = {.from = square, .to = tosquare};
-                            _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-                        }
-                    }
-                    else
-                    {
-                        bool is_blocked = false;
-                        for (int8_t row = upper_rook.row - 1; row > square.row; row--)
-                        {
-                            chesscat_Square checking = {.col = square.col, .row = row};
-                            if (chesscat_get_piece_at_square(position, checking).type != Empty)
-                            {
-                                is_blocked = true;
-                                break;
-                            }
-                        }
-                        if (!is_blocked)
-                        {
-                            chesscat_Square tosquare = {.col = square.col, .row = square.row + 2};
-
-                            chesscat_Move move = {.from = square, .to = tosquare};
-                            _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-                        }
-                    }
+        }
+    }
+    if (piece.type != Empty)
+    {
+        position->material[piece.color] += _chesscat_piece_value(piece);
+        if (geometry != NULL)
+        {
+            position->piece_squares[piece.color] += geometry->piece_squares[piece.color][piece.type][index];
+        }
+        _chesscat_bitboard_set(&(position->occupied), index);
+        _chesscat_bitboard_set(&(position->color_occupancy[piece.color]), index);
+        _chesscat_bitboard_set(&(position->type_occupancy[piece.type]), index);
+        _chesscat_piece_list_add(position, piece.color, index);
+        if (piece.is_royal)
+        {
+            _chesscat_bitboard_set(&(position->royal_occupancy), index);
+            position->royal_count[piece.color]++;
+        }
+        if (piece.type == King && position->color_data[piece.color].king_square == CHESSCAT_NUM_SQUARES)
+        {
+            position->color_data[piece.color].king_square = index;
+        }
+    }
+}
+
+/*
+ * _chesscat_clear_board
+ *
+ * Empties every square of the position's board, including those outside the current board size, and resets the bitboards and piece lists.
+ * The mailbox border is laid out for the current board size, so set the size before calling this.
+ * The hash is cleared too, and only tracks pieces set afterwards: reset it with chesscat_compute_hash once the position is set up.
+ * The pawn hash and the material and piece-square sums are cleared, and track every piece set afterwards. The network accumulators are
+ * marked out of date, and are rebuilt by the next network evaluation
+ */
+void _chesscat_clear_board(chesscat_Position *position)
+{
+    chesscat_Piece empty = {.color = White, .is_royal = false, .type = Empty};
+    chesscat_Square none = {.row = -1, .col = -1};
+    _chesscat_init_zobrist_keys();
+    position->hash = 0;
+    position->pawn_hash = 0;
+    position->network_id = 0;
+    for (uint8_t row = 0; row < CHESSCAT_MAX_BOARD_SIZE; row++)
+    {
+        for (uint8_t col = 0; col < CHESSCAT_MAX_BOARD_SIZE; col++)
+        {
+            position->board[row][col] = empty;
+        }
+    }
+    for (uint16_t i = 0; i < CHESSCAT_MAILBOX_SIZE; i++)
+    {
+        position->mailbox[i] = CHESSCAT_MAILBOX_OFF_BOARD;
+    }
+    for (uint8_t row = 0; row < position->game_rules.board_height; row++)
+    {
+        for (uint8_t col = 0; col < position->game_rules.board_width; col++)
+        {
+            position->mailbox[_chesscat_mailbox_index(row, col)] = CHESSCAT_MAILBOX_EMPTY;
+        }
+    }
+    _chesscat_bitboard_clear_all(&(position->occupied));
+    _chesscat_bitboard_clear_all(&(position->royal_occupancy));
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        _chesscat_bitboard_clear_all(&(position->color_occupancy[color]));
+        position->piece_count[color] = 0;
+        position->royal_count[color] = 0;
+        position->material[color] = 0;
+        position->piece_squares[color] = 0;
+        position->color_data[color].king_square = CHESSCAT_NUM_SQUARES;
+        position->color_data[color].lower_rook_square = none;
+        position->color_data[color].upper_rook_square = none;
+    }
+    for (uint8_t type = 0; type < CHESSCAT_NUM_PIECE_TYPES; type++)
+    {
+        _chesscat_bitboard_clear_all(&(position->type_occupancy[type]));
+    }
+}
+
+void chesscat_set_piece_at_square(chesscat_Position *position, chesscat_Square square, chesscat_Piece piece)
+{
+    _chesscat_set_piece(position, square.row, square.col, piece);
+}
+
+chesscat_Piece _chesscat_get_piece(chesscat_Position *position, int8_t row, int8_t col)
+{
+    return position->board[row][col];
+}
+
+chesscat_Piece chesscat_get_piece_at_square(chesscat_Position *position, chesscat_Square square)
+{
+    return _chesscat_get_piece(position, square.row, square.col);
+}
+
+chesscat_Square _chesscat_find_king(chesscat_Position *position, chesscat_EColor color)
+{
+    uint16_t index = position->color_data[color].king_square;
+    if (index == CHESSCAT_NUM_SQUARES)
+    {
+        chesscat_Square none = {.row = -1, .col = -1};
+        return none;
+    }
+    return _chesscat_index_square(index);
+}
+
+bool _chesscat_has_royal(chesscat_Position *position, chesscat_EColor color){
+    return position->royal_count[color] > 0;
+}
+
+uint16_t _chesscat_count_pieces(chesscat_Position *position, chesscat_EColor color){
+    return position->piece_count[color];
+}
+
+chesscat_Square _chesscat_find_lower_rook(chesscat_Position *position, chesscat_EColor color)
+{ // Finds the nearest lower-coordinate rook on the specified color's king's rank (or file, for Green and Red)
+    chesscat_Square none = {.row = -1, .col = -1};
+    chesscat_Square king_square = _chesscat_find_king(position, color);
+    if (!chesscat_is_valid_square(king_square))
+    {
+        return none;
+    }
+    bool along_row = (color == White || color == Black);
+    chesscat_Square found = none;
+    for (uint16_t i = 0; i < position->piece_count[color]; i++)
+    {
+        chesscat_Square square = _chesscat_index_square(position->piece_list[color][i]);
+        if (chesscat_get_piece_at_square(position, square).type != Rook)
+        {
+            continue;
+        }
+        if (along_row && square.row == king_square.row && square.col < king_square.col && square.col > found.col)
+        {
+            found = square;
+        }
+        else if (!along_row && square.col == king_square.col && square.row < king_square.row && square.row > found.row)
+        {
+            found = square;
+        }
+    }
+    return found;
+}
+
+chesscat_Square _chesscat_find_upper_rook(chesscat_Position *position, chesscat_EColor color)
+{ // Finds the nearest higher-coordinate rook on the specified color's king's rank (or file, for Green and Red)
+    chesscat_Square none = {.row = -1, .col = -1};
+    chesscat_Square king_square = _chesscat_find_king(position, color);
+    if (!chesscat_is_valid_square(king_square))
+    {
+        return none;
+    }
+    bool along_row = (color == White || color == Black);
+    chesscat_Square found = none;
+    for (uint16_t i = 0; i < position->piece_count[color]; i++)
+    {
+        chesscat_Square square = _chesscat_index_square(position->piece_list[color][i]);
+        if (chesscat_get_piece_at_square(position, square).type != Rook)
+        {
+            continue;
+        }
+        if (along_row && square.row == king_square.row && square.col > king_square.col && (found.col == -1 || square.col < found.col))
+        {
+            found = square;
+        }
+        else if (!along_row && square.col == king_square.col && square.row > king_square.row && (found.row == -1 || square.row < found.row))
+        {
+            found = square;
+        }
+    }
+    return found;
+}
+
+/*
+ * _chesscat_set_castle_rooks
+ *
+ * Caches each color's castling rooks, the nearest rook on either side of its king. Call once the pieces are set up;
+ * moves then keep the cache up to date, so castling never has to search for its rooks
+ */
+void _chesscat_set_castle_rooks(chesscat_Position *position)
+{
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        position->color_data[color].lower_rook_square = _chesscat_find_lower_rook(position, color);
+        position->color_data[color].upper_rook_square = _chesscat_find_upper_rook(position, color);
+    }
+}
+
+/*
+ * _chesscat_get_castle_rook
+ *
+ * Returns the square of the color's cached castling rook on the given side, or -1 -1 if that side cannot castle
+ */
+chesscat_Square _chesscat_get_castle_rook(chesscat_Position *position, chesscat_EColor color, bool upper)
+{
+    chesscat_Square none = {.row = -1, .col = -1};
+    _chesscat_ColorData *color_data = &(position->color_data[color]);
+    chesscat_Square rook = upper ? color_data->upper_rook_square : color_data->lower_rook_square;
+    if (!chesscat_is_valid_square(rook) || (upper ? color_data->has_upper_rook_moved : color_data->has_lower_rook_moved))
+    {
+        return none;
+    }
+    chesscat_Piece piece = chesscat_get_piece_at_square(position, rook);
+    if (piece.type != Rook || piece.color != color)
+    { // The board was edited directly since the cache was set
+        return none;
+    }
+    return rook;
+}
+
+void _chesscat_set_next_to_play(chesscat_Position *position)
+{
+    if (position->color_data[White].is_in_game == false &&
+        position->color_data[Black].is_in_game == false &&
+        position->color_data[Green].is_in_game == false &&
+        position->color_data[Red].is_in_game == false)
+    {
+        return;
+    }
+    position->hash ^= _chesscat_zobrist_keys.to_move[position->to_move];
+    switch (position->to_move)
+    {
+    case White:
+        position->to_move = Red;
+        break;
+    case Red:
+        position->to_move = Black;
+        break;
+    case Black:
+        position->to_move = Green;
+        break;
+    default:
+        position->to_move = White;
+        break;
+    }
+    uint8_t i = 0;
+    while (
+        (
+            !(position->color_data[position->to_move].is_in_game) || (
+                !_chesscat_has_royal(position, position->to_move) && !(position->game_rules.capture_all)
+            )
+        ) &&
+        i < CHESSCAT_NUM_COLORS)
+    {
+        i++;
+        switch (position->to_move)
+        {
+        case White:
+            position->to_move = Red;
+            break;
+        case Red:
+            position->to_move = Black;
+            break;
+        case Black:
+            position->to_move = Green;
+            break;
+        default:
+            position->to_move = White;
+            break;
+        }
+    }
+    position->hash ^= _chesscat_zobrist_keys.to_move[position->to_move];
+}
+
+_chesscat_EMoveCasleType _chesscat_move_castles(chesscat_Position *position, chesscat_Move move)
+{
+    int8_t coldist = move.to.col - move.from.col;
+    int8_t rowdist = move.to.row - move.from.row;
+
+    chesscat_Piece piece = chesscat_get_piece_at_square(position, move.from);
+    if (piece.type == King && piece.is_royal && (abs(rowdist) > 1 || abs(coldist) > 1))
+    {
+        if (rowdist > 0 || coldist > 0)
+        {
+            return UpperCastle;
+        }
+        if (rowdist < 0 || coldist < 0)
+        {
+            return LowerCastle;
+        }
+    }
+    return NotCastle;
+}
+
+bool _chesscat_color_can_capture_piece(chesscat_Position *position, chesscat_EColor color, chesscat_Piece piece)
+{
+    // NOTE: Position is used here because gamerules may change what colors can be captured
+    if(piece.type != Empty){
+        if(piece.color == color){
+            if(!(position->game_rules.capture_own)){
+                return false;
+            }
+            if(piece.type == King){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * _chesscat_add_move_to_buf
+ *
+ * Counts a move, writing it to moves_buf only while there is room for it. The count carries on past max_moves,
+ * so callers can tell that the buffer overflowed
+ */
+void _chesscat_add_move_to_buf(chesscat_Move move, chesscat_Move moves_buf[], uint16_t max_moves, uint16_t *num_moves)
+{
+    if (moves_buf != NULL && *num_moves < max_moves)
+    {
+        moves_buf[*num_moves] = move;
+    }
+    (*num_moves)++;
+}
+
+/*
+ * chesscat_get_max_moves
+ *
+ * Returns an upper bound on the number of moves, packed or not, in any position played with the given rules.
+ * Every square could hold a piece of the color to play with as many moves as a queen in the middle of the board,
+ * or as a promoting pawn if that is more. Buffers of this size never overflow
+ */
+uint16_t chesscat_get_max_moves(chesscat_GameRules *rules)
+{
+    uint8_t width = rules->board_width;
+    uint8_t height = rules->board_height;
+    if (width == 0 || height == 0)
+    {
+        return 0;
+    }
+    uint8_t shorter = width < height ? width : height;
+    uint16_t piece_moves = (width - 1) + (height - 1) + 2 * (shorter - 1);
+    if (piece_moves < CHESSCAT_MAX_PAWN_MOVES_FROM_SQUARE)
+    {
+        piece_moves = CHESSCAT_MAX_PAWN_MOVES_FROM_SQUARE;
+    }
+    return width * height * piece_moves;
+}
+
+/*   Packed move functions   */
+
+chesscat_PackedMove chesscat_pack_move(uint16_t from, uint16_t to, chesscat_EPieceType piece, chesscat_EPieceType captured, chesscat_EPieceType promotion, uint32_t flags)
+{
+    return ((uint32_t)from << CHESSCAT_MOVE_FROM_SHIFT) |
+           ((uint32_t)to << CHESSCAT_MOVE_TO_SHIFT) |
+           ((uint32_t)piece << CHESSCAT_MOVE_PIECE_SHIFT) |
+           ((uint32_t)captured << CHESSCAT_MOVE_CAPTURED_SHIFT) |
+           ((uint32_t)promotion << CHESSCAT_MOVE_PROMOTION_SHIFT) |
+           flags;
+}
+
+uint16_t chesscat_packed_move_from(chesscat_PackedMove move)
+{
+    return (move >> CHESSCAT_MOVE_FROM_SHIFT) & CHESSCAT_MOVE_SQUARE_MASK;
+}
+
+uint16_t chesscat_packed_move_to(chesscat_PackedMove move)
+{
+    return (move >> CHESSCAT_MOVE_TO_SHIFT) & CHESSCAT_MOVE_SQUARE_MASK;
+}
+
+chesscat_EPieceType chesscat_packed_move_piece(chesscat_PackedMove move)
+{
+    return (move >> CHESSCAT_MOVE_PIECE_SHIFT) & CHESSCAT_MOVE_TYPE_MASK;
+}
+
+chesscat_EPieceType chesscat_packed_move_captured(chesscat_PackedMove move)
+{
+    return (move >> CHESSCAT_MOVE_CAPTURED_SHIFT) & CHESSCAT_MOVE_TYPE_MASK;
+}
+
+chesscat_EPieceType chesscat_packed_move_promotion(chesscat_PackedMove move)
+{
+    return (move >> CHESSCAT_MOVE_PROMOTION_SHIFT) & CHESSCAT_MOVE_TYPE_MASK;
+}
+
+chesscat_Move chesscat_unpack_move(chesscat_PackedMove move)
+{
+    chesscat_Move unpacked = {.from = _chesscat_index_square(chesscat_packed_move_from(move)), .to = _chesscat_index_square(chesscat_packed_move_to(move))};
+    return unpacked;
+}
+
+/*
+ * chesscat_encode_move
+ *
+ * Packs a move played in the given position, working out the moving and captured pieces and the move flags.
+ * The promotion is only kept for pawn moves onto the promotion rank
+ */
+chesscat_PackedMove chesscat_encode_move(chesscat_Position *position, chesscat_Move move, chesscat_EPieceType promotion)
+{
+    chesscat_Piece moving = chesscat_get_piece_at_square(position, move.from);
+    chesscat_Piece target = chesscat_get_piece_at_square(position, move.to);
+    chesscat_EPieceType captured = target.type;
+    chesscat_EPieceType promotes_to = Empty;
+    uint32_t flags = 0;
+
+    if (_chesscat_move_castles(position, move) != NotCastle)
+    {
+        flags |= CHESSCAT_MOVE_CASTLE_FLAG;
+    }
+    if (moving.type == Pawn)
+    {
+        int8_t row_dist = abs(move.to.row - move.from.row);
+        int8_t col_dist = abs(move.to.col - move.from.col);
+        if (row_dist > 1 || col_dist > 1)
+        {
+            flags |= CHESSCAT_MOVE_DOUBLE_PUSH_FLAG;
+        }
+        if (row_dist != 0 && col_dist != 0 && target.type == Empty && _chesscat_same_squares(move.to, position->passantable_square))
+        {
+            flags |= CHESSCAT_MOVE_PASSANT_FLAG;
+            captured = chesscat_get_piece_at_square(position, position->passant_target_square).type;
+        }
+        if (promotion != Empty && _chesscat_square_on_promotion_rank(position, move.to, moving.color))
+        {
+            promotes_to = promotion;
+        }
+    }
+    return chesscat_pack_move(_chesscat_square_index(move.from), _chesscat_square_index(move.to), moving.type, captured, promotes_to, flags);
+}
+
+void _chesscat_add_packed_move(chesscat_PackedMove moves_buf[], uint16_t *num_moves, chesscat_PackedMove move)
+{
+    moves_buf[*num_moves] = move;
+    (*num_moves)++;
+}
+
+/*
+ * _chesscat_mode_wants
+ *
+ * Returns whether a generation mode wants a move that does or does not capture. Promotions count as captures
+ */
+bool _chesscat_mode_wants(chesscat_EGenerationMode mode, bool is_capture)
+{
+    switch (mode)
+    {
+    case GenerateCaptures:
+        return is_capture;
+    case GenerateQuiets:
+    case GenerateChecks:
+        return !is_capture;
+    default:
+        return true;
+    }
+}
+
+/*
+ * _chesscat_add_pawn_move
+ *
+ * Adds a pawn move, or one move per promotion piece if it lands on the pawn's promotion rank, if the generation mode wants it
+ */
+void _chesscat_add_pawn_move(chesscat_Position *position, chesscat_EColor color, chesscat_Square from, chesscat_Square to, chesscat_EPieceType captured, uint32_t flags, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[], uint16_t *num_moves)
+{
+    static const chesscat_EPieceType promotions[4] = {Queen, Rook, Bishop, Knight};
+    uint16_t from_index = _chesscat_square_index(from);
+    uint16_t to_index = _chesscat_square_index(to);
+    bool promotes = _chesscat_square_on_promotion_rank(position, to, color);
+    if (!_chesscat_mode_wants(mode, promotes || captured != Empty))
+    {
+        return;
+    }
+    if (promotes)
+    {
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            _chesscat_add_packed_move(moves_buf, num_moves, chesscat_pack_move(from_index, to_index, Pawn, captured, promotions[i], flags));
+        }
+        return;
+    }
+    _chesscat_add_packed_move(moves_buf, num_moves, chesscat_pack_move(from_index, to_index, Pawn, captured, Empty, flags));
+}
+
+/*
+ * _chesscat_pawn_pushes_wanted
+ *
+ * Returns whether a pawn's pushes need generating: always, unless only captures are wanted and the pawn is
+ * too far from its promotion rank for a push to promote
+ */
+bool _chesscat_pawn_pushes_wanted(chesscat_Position *position, chesscat_EColor color, chesscat_Square advance_square, chesscat_Square double_advance_square, chesscat_EGenerationMode mode)
+{
+    return mode != GenerateCaptures ||
+           _chesscat_square_on_promotion_rank(position, advance_square, color) ||
+           _chesscat_square_on_promotion_rank(position, double_advance_square, color);
+}
+
+/*
+ * _chesscat_add_castle_moves
+ *
+ * Adds the castling moves of the royal king on the given square.
+ * White and Black castle along their king's row, Green and Red along their king's column
+ */
+void _chesscat_add_castle_moves(chesscat_Position *position, chesscat_Square square, chesscat_Piece piece, chesscat_PackedMove moves_buf[], uint16_t *num_moves)
+{
+    if (!position->game_rules.allow_castle || piece.type != King || !piece.is_royal || position->color_data[piece.color].has_king_moved)
+    {
+        return;
+    }
+    bool along_row = (piece.color == White || piece.color == Black);
+    for (int8_t direction = -1; direction <= 1; direction += 2)
+    {
+        bool upper = direction > 0;
+        chesscat_Square rook = _chesscat_get_castle_rook(position, piece.color, upper);
+        if (!chesscat_is_valid_square(rook))
+        {
+            continue;
+        }
+        int8_t row_step = along_row ? 0 : direction;
+        int8_t col_step = along_row ? direction : 0;
+        if (abs(rook.row - square.row) + abs(rook.col - square.col) < 2)
+        {
+            continue;
+        }
+        bool is_blocked = false;
+        chesscat_Square checking = {.row = square.row + row_step, .col = square.col + col_step};
+        while (!_chesscat_same_squares(checking, rook))
+        {
+            if (chesscat_get_piece_at_square(position, checking).type != Empty)
+            {
+                is_blocked = true;
+                break;
+            }
+            checking.row += row_step;
+            checking.col += col_step;
+        }
+        if (!is_blocked)
+        {
+            chesscat_Square tosquare = {.row = square.row + row_step * 2, .col = square.col + col_step * 2};
+            _chesscat_add_packed_move(moves_buf, num_moves, chesscat_pack_move(_chesscat_square_index(square), _chesscat_square_index(tosquare), King, Empty, Empty, CHESSCAT_MOVE_CASTLE_FLAG));
+        }
+    }
+}
+
+/*
+ * _chesscat_mailbox_can_capture
+ *
+ * Mailbox version of _chesscat_color_can_capture_piece. Returns false for off-board cells
+ */
+bool _chesscat_mailbox_can_capture(chesscat_Position *position, chesscat_EColor color, uint8_t code)
+{
+    if (code == CHESSCAT_MAILBOX_EMPTY)
+    {
+        return true;
+    }
+    if (code == CHESSCAT_MAILBOX_OFF_BOARD)
+    {
+        return false;
+    }
+    if (((code >> 3) & 3) == color)
+    {
+        return position->game_rules.capture_own && (code & 7) != King;
+    }
+    return true;
+}
+
+/*
+ * _chesscat_generate_moves_from_mailbox
+ *
+ * Mailbox version of chesscat_generate_moves_from. Leaps and ray steps are fixed offsets into the padded
+ * mailbox, and stop on the off-board sentinel cells instead of testing coordinates
+ */
+uint16_t _chesscat_generate_moves_from_mailbox(chesscat_Position *position, chesscat_Square square, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[])
+{
+    const int16_t stride = CHESSCAT_MAILBOX_STRIDE;
+    uint8_t *mailbox = position->mailbox;
+    uint16_t from = _chesscat_mailbox_index(square.row, square.col);
+    uint16_t from_index = _chesscat_square_index(square);
+    chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
+    bool wants_captures = _chesscat_mode_wants(mode, true);
+    bool wants_quiets = _chesscat_mode_wants(mode, false);
+    uint16_t num_moves = 0;
+
+    if (piece.type == King || piece.type == Knight)
+    {
+        const int8_t (*offsets)[2] = piece.type == King ? _chesscat_king_offsets : _chesscat_knight_offsets;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            uint8_t code = mailbox[from + offsets[i][0] * stride + offsets[i][1]];
+            if ((code == CHESSCAT_MAILBOX_EMPTY ? wants_quiets : wants_captures) && _chesscat_mailbox_can_capture(position, piece.color, code))
+            {
+                uint16_t to_index = from_index + offsets[i][0] * CHESSCAT_MAX_BOARD_SIZE + offsets[i][1];
+                _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(from_index, to_index, piece.type, code & 7, Empty, 0));
+            }
+        }
+        if (piece.type == King && wants_quiets)
+        {
+            _chesscat_add_castle_moves(position, square, piece, moves_buf, &num_moves);
+        }
+    }
+    else if (piece.type == Queen || piece.type == Rook || piece.type == Bishop)
+    {
+        uint8_t first_ray = piece.type == Rook ? 4 : 0;
+        uint8_t last_ray = piece.type == Bishop ? 4 : 8;
+        for (uint8_t ray = first_ray; ray < last_ray; ray++)
+        {
+            int16_t step = _chesscat_ray_steps[ray][0] * stride + _chesscat_ray_steps[ray][1];
+            int16_t index_step = _chesscat_ray_steps[ray][0] * CHESSCAT_MAX_BOARD_SIZE + _chesscat_ray_steps[ray][1];
+            uint16_t to = from + step;
+            uint16_t to_index = from_index + index_step;
+            while (mailbox[to] == CHESSCAT_MAILBOX_EMPTY)
+            {
+                if (wants_quiets)
+                {
+                    _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(from_index, to_index, piece.type, Empty, Empty, 0));
+                }
+                to += step;
+                to_index += index_step;
+            }
+            if (wants_captures && mailbox[to] != CHESSCAT_MAILBOX_OFF_BOARD && _chesscat_mailbox_can_capture(position, piece.color, mailbox[to]))
+            {
+                _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(from_index, to_index, piece.type, mailbox[to] & 7, Empty, 0));
+            }
+        }
+    }
+    else if (piece.type == Pawn)
+    {
+        chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+        if (geometry == NULL)
+        {
+            return 0;
+        }
+        int8_t row_dist;
+        int8_t col_dist;
+        _chesscat_pawn_direction(piece.color, &row_dist, &col_dist);
+        int16_t push = row_dist * stride + col_dist;
+        int16_t side_step = col_dist * stride + row_dist;
+        chesscat_Square advance_square = {.row = square.row + row_dist, .col = square.col + col_dist};
+        chesscat_Square double_advance_square = {.row = square.row + row_dist * 2, .col = square.col + col_dist * 2};
+        uint8_t advance_code = mailbox[from + push];
+
+        if (advance_code != CHESSCAT_MAILBOX_OFF_BOARD)
+        {
+            // The border is only two cells wide, so check the first step is on the board before looking at the second
+            uint8_t double_advance_code = mailbox[from + push * 2];
+            if (_chesscat_pawn_pushes_wanted(position, piece.color, advance_square, double_advance_square, mode))
+            {
+                if (advance_code == CHESSCAT_MAILBOX_EMPTY)
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, advance_square, Empty, 0, mode, moves_buf, &num_moves);
+                    if ((position->game_rules.torpedo_pawns || geometry->pawn_on_start_rank[piece.color][from_index]) &&
+                        double_advance_code == CHESSCAT_MAILBOX_EMPTY)
+                    {
+                        _chesscat_add_pawn_move(position, piece.color, square, double_advance_square, Empty, CHESSCAT_MOVE_DOUBLE_PUSH_FLAG, mode, moves_buf, &num_moves);
+                    }
+                }
+                else if (position->game_rules.kangaroo_pawns && double_advance_code == CHESSCAT_MAILBOX_EMPTY)
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, double_advance_square, Empty, CHESSCAT_MOVE_DOUBLE_PUSH_FLAG, mode, moves_buf, &num_moves);
+                }
+            }
+            for (int8_t side = -1; side <= 1 && wants_captures; side += 2)
+            {
+                uint8_t take_code = mailbox[from + push + side * side_step];
+                chesscat_Square take_square = {.row = advance_square.row + side * col_dist, .col = advance_square.col + side * row_dist};
+                if (take_code != CHESSCAT_MAILBOX_EMPTY && _chesscat_mailbox_can_capture(position, piece.color, take_code))
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, take_square, take_code & 7, 0, mode, moves_buf, &num_moves);
+                }
+                else if (take_code == CHESSCAT_MAILBOX_EMPTY && _chesscat_same_squares(take_square, position->passantable_square))
+                {
+                    chesscat_EPieceType captured = chesscat_get_piece_at_square(position, position->passant_target_square).type;
+                    _chesscat_add_pawn_move(position, piece.color, square, take_square, captured, CHESSCAT_MOVE_PASSANT_FLAG, mode, moves_buf, &num_moves);
+                }
+            }
+        }
+
+        if (position->game_rules.sideways_pawns)
+        {
+            for (int8_t side = -1; side <= 1; side += 2)
+            {
+                uint8_t side_code = mailbox[from + side * side_step];
+                if (_chesscat_mailbox_can_capture(position, piece.color, side_code))
+                {
+                    chesscat_Square side_square = {.row = square.row + side * col_dist, .col = square.col + side * row_dist};
+                    _chesscat_add_pawn_move(position, piece.color, square, side_square, side_code & 7, 0, mode, moves_buf, &num_moves);
+                }
+            }
+        }
+    }
+
+    return num_moves;
+}
+
+void _chesscat_add_attacker(chesscat_Square square, chesscat_Square attackers[], uint8_t *num_attackers)
+{
+    if (attackers != NULL)
+    {
+        attackers[*num_attackers] = square;
+    }
+    (*num_attackers)++;
+}
+
+/*
+ * _chesscat_find_attackers
+ *
+ * Finds pieces of by_color that could capture on the given square, whatever is on it and whoever is to play.
+ * Probes outward from the square along rays and leaper offsets instead of generating moves, and follows the
+ * game rules for which pieces can be captured (capture_own) and how pawns capture (sideways_pawns).
+ * Kangaroo and torpedo pawn moves never capture, so they never attack a square.
+ * Stops after max_attackers are found. Their squares are written to attackers if it is not NULL
+ */
+uint8_t _chesscat_find_attackers(chesscat_Position *position, chesscat_Square square, chesscat_EColor by_color, chesscat_Square attackers[], uint8_t max_attackers)
+{
+    uint8_t num_attackers = 0;
+    if (!_chesscat_color_can_capture_piece(position, by_color, chesscat_get_piece_at_square(position, square)))
+    {
+        return 0;
+    }
+    chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+    if (geometry == NULL)
+    {
+        return 0;
+    }
+    uint16_t index = _chesscat_square_index(square);
+
+    // Leaper moves are symmetric, so a leaper attacks this square from any square it could leap to from here
+    for (uint8_t i = 0; i < geometry->num_knight_targets[index]; i++)
+    {
+        chesscat_Square from = geometry->knight_targets[index][i];
+        chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+        if (piece.type == Knight && piece.color == by_color)
+        {
+            _chesscat_add_attacker(from, attackers, &num_attackers);
+            if (num_attackers >= max_attackers)
+            {
+                return num_attackers;
+            }
+        }
+    }
+    for (uint8_t i = 0; i < geometry->num_king_targets[index]; i++)
+    {
+        chesscat_Square from = geometry->king_targets[index][i];
+        chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+        if (piece.type == King && piece.color == by_color)
+        {
+            _chesscat_add_attacker(from, attackers, &num_attackers);
+            if (num_attackers >= max_attackers)
+            {
+                return num_attackers;
+            }
+        }
+    }
+
+    for (uint8_t ray = 0; ray < 8; ray++)
+    {
+        bool diagonal = ray < 4;
+        chesscat_Square checking = square;
+        for (uint8_t step = 0; step < geometry->ray_lengths[index][ray]; step++)
+        {
+            checking.row += _chesscat_ray_steps[ray][0];
+            checking.col += _chesscat_ray_steps[ray][1];
+            chesscat_Piece hit = chesscat_get_piece_at_square(position, checking);
+            if (hit.type != Empty)
+            {
+                if (hit.color == by_color &&
+                    (hit.type == Queen || (diagonal && hit.type == Bishop) || (!diagonal && hit.type == Rook)))
+                {
+                    _chesscat_add_attacker(checking, attackers, &num_attackers);
+                    if (num_attackers >= max_attackers)
+                    {
+                        return num_attackers;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < geometry->num_pawn_attackers[by_color][index]; i++)
+    {
+        chesscat_Square from = geometry->pawn_attackers[by_color][index][i];
+        chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+        if (piece.type == Pawn && piece.color == by_color)
+        {
+            _chesscat_add_attacker(from, attackers, &num_attackers);
+            if (num_attackers >= max_attackers)
+            {
+                return num_attackers;
+            }
+        }
+    }
+    if (position->game_rules.sideways_pawns)
+    { // Sideways moves are symmetric too
+        for (uint8_t i = 0; i < geometry->num_pawn_sideways[by_color][index]; i++)
+        {
+            chesscat_Square from = geometry->pawn_sideways[by_color][index][i];
+            chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+            if (piece.type == Pawn && piece.color == by_color)
+            {
+                _chesscat_add_attacker(from, attackers, &num_attackers);
+                if (num_attackers >= max_attackers)
+                {
+                    return num_attackers;
+                }
+            }
+        }
+    }
+    return num_attackers;
+}
+
+/*
+ * chesscat_is_square_attacked
+ *
+ * Returns whether a piece of by_color could capture on the given square, whatever is on it and whoever is to play
+ */
+bool chesscat_is_square_attacked(chesscat_Position *position, chesscat_Square square, chesscat_EColor by_color)
+{
+    return _chesscat_find_attackers(position, square, by_color, NULL, 1) > 0;
+}
+
+/*
+ * _chesscat_is_square_attacked_by_opponents
+ *
+ * Returns whether any other color still in the game attacks the given square
+ */
+bool _chesscat_is_square_attacked_by_opponents(chesscat_Position *position, chesscat_Square square, chesscat_EColor color)
+{
+    for (uint8_t other = 0; other < CHESSCAT_NUM_COLORS; other++)
+    {
+        if (other == color || !position->color_data[other].is_in_game)
+        {
+            continue;
+        }
+        if (chesscat_is_square_attacked(position, square, other))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool _chesscat_can_royal_be_captured(chesscat_Position *position)
+{ // Whether a royal can be captured in the given position
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        if (color == position->to_move || position->royal_count[color] == 0)
+        {
+            continue;
+        }
+        chesscat_Bitboard royals;
+        _chesscat_bitboard_intersect(&royals, &(position->royal_occupancy), &(position->color_occupancy[color]));
+        uint16_t index;
+        while ((index = _chesscat_bitboard_pop_first(&royals)) != CHESSCAT_NUM_SQUARES)
+        {
+            if (chesscat_is_square_attacked(position, _chesscat_index_square(index), position->to_move))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * _chesscat_set_piece_recorded
+ *
+ * Sets a piece, first saving the square's previous contents to undo if it is not NULL
+ */
+void _chesscat_set_piece_recorded(chesscat_Position *position, chesscat_Square square, chesscat_Piece piece, chesscat_MoveUndo *undo)
+{
+    if (undo != NULL)
+    {
+        undo->squares[undo->num_squares] = square;
+        undo->pieces[undo->num_squares] = chesscat_get_piece_at_square(position, square);
+        undo->num_squares++;
+    }
+    chesscat_set_piece_at_square(position, square, piece);
+}
+
+/*
+ * _chesscat_get_castle_rook_move
+ *
+ * Looks up the cached rook that castles with a king move and the square it lands on, next to the king on the side
+ * it came from. rook_from is invalid if there is no rook on that side
+ */
+void _chesscat_get_castle_rook_move(chesscat_Position *position, chesscat_Square king_from, chesscat_Square king_to, chesscat_EColor color, chesscat_Square *rook_from, chesscat_Square *rook_to)
+{
+    chesscat_Square none = {.row = -1, .col = -1};
+    int8_t row_step = (king_to.row > king_from.row) - (king_to.row < king_from.row);
+    int8_t col_step = (king_to.col > king_from.col) - (king_to.col < king_from.col);
+    bool upper = row_step > 0 || col_step > 0;
+    *rook_from = upper ? position->color_data[color].upper_rook_square : position->color_data[color].lower_rook_square;
+    if (chesscat_is_valid_square(*rook_from) && chesscat_get_piece_at_square(position, *rook_from).type != Rook)
+    {
+        *rook_from = none;
+    }
+    rook_to->row = king_to.row - row_step;
+    rook_to->col = king_to.col - col_step;
+}
+
+/*
+ * _chesscat_move_packed_pieces
+ *
+ * Sets the new positions of pieces according to a packed move, including captures, castles, en passants and promotions
+ * Does not set other positional data such as the color to play or pieces captured
+ */
+void _chesscat_move_packed_pieces(chesscat_Position *position, chesscat_PackedMove move, chesscat_MoveUndo *undo)
+{
+    chesscat_Piece empty = {.color = White, .is_royal = false, .type = Empty};
+    chesscat_Square from = _chesscat_index_square(chesscat_packed_move_from(move));
+    chesscat_Square to = _chesscat_index_square(chesscat_packed_move_to(move));
+    chesscat_Piece moving = chesscat_get_piece_at_square(position, from);
+    chesscat_EPieceType promotion = chesscat_packed_move_promotion(move);
+
+    if (promotion != Empty)
+    {
+        moving.type = promotion;
+        moving.is_royal = false;
+    }
+    if (move & CHESSCAT_MOVE_CASTLE_FLAG)
+    {
+        chesscat_Square rook_from;
+        chesscat_Square rook_to;
+        _chesscat_get_castle_rook_move(position, from, to, moving.color, &rook_from, &rook_to);
+        if (chesscat_is_valid_square(rook_from))
+        { // Lift both pieces first, since the king may land where the rook stood
+            chesscat_Piece rook = chesscat_get_piece_at_square(position, rook_from);
+            _chesscat_set_piece_recorded(position, from, empty, undo);
+            _chesscat_set_piece_recorded(position, rook_from, empty, undo);
+            _chesscat_set_piece_recorded(position, rook_to, rook, undo);
+            _chesscat_set_piece_recorded(position, to, moving, undo);
+            return;
+        }
+    }
+    if (move & CHESSCAT_MOVE_PASSANT_FLAG)
+    {
+        _chesscat_set_piece_recorded(position, position->passant_target_square, empty, undo);
+    }
+    _chesscat_set_piece_recorded(position, to, moving, undo);
+    _chesscat_set_piece_recorded(position, from, empty, undo);
+}
+
+/*
+ * chesscat_move_pieces
+ *
+ * Sets the new positions of pieces according to a move, including captures, castles, and en passants
+ * Does not set other positional data such as the color to play or pieces captured
+ */
+void chesscat_move_pieces(chesscat_Position *position, chesscat_Move move)
+{
+    _chesscat_move_packed_pieces(position, chesscat_encode_move(position, move, Empty), NULL);
+}
+
+/*
+ * _chesscat_make_packed_move
+ *
+ * Plays a packed move, setting all positional data as required. Castling rights are checked against the cached
+ * castling rook squares, so moving or capturing a rook costs no search. The hash is updated as each part changes
+ */
+void _chesscat_make_packed_move(chesscat_Position *position, chesscat_PackedMove move, chesscat_MoveUndo *undo)
+{
+    chesscat_Square none = {.row = -1, .col = -1};
+    chesscat_Square from = _chesscat_index_square(chesscat_packed_move_from(move));
+    chesscat_Square to = _chesscat_index_square(chesscat_packed_move_to(move));
+    chesscat_EPieceType moving_type = chesscat_packed_move_piece(move);
+    _chesscat_ColorData *color_data = &(position->color_data[position->to_move]);
+
+    position->hash ^= _chesscat_castling_key(position);
+    if (moving_type == King)
+    {
+        color_data->has_king_moved = true;
+        if (move & CHESSCAT_MOVE_CASTLE_FLAG)
+        {
+            if (to.row > from.row || to.col > from.col)
+            {
+                color_data->has_upper_rook_moved = true;
+            }
+            else
+            {
+                color_data->has_lower_rook_moved = true;
+            }
+        }
+    }
+    else if (moving_type == Rook)
+    {
+        if (_chesscat_same_squares(from, color_data->lower_rook_square))
+        {
+            color_data->has_lower_rook_moved = true;
+        }
+        else if (_chesscat_same_squares(from, color_data->upper_rook_square))
+        {
+            color_data->has_upper_rook_moved = true;
+        }
+    }
+    if (chesscat_packed_move_captured(move) == Rook && !(move & CHESSCAT_MOVE_PASSANT_FLAG))
+    { // A captured castling rook takes its side's castle with it
+        chesscat_EColor captured_color = chesscat_get_piece_at_square(position, to).color;
+        if (_chesscat_same_squares(to, position->color_data[captured_color].lower_rook_square))
+        {
+            position->color_data[captured_color].has_lower_rook_moved = true;
+        }
+        else if (_chesscat_same_squares(to, position->color_data[captured_color].upper_rook_square))
+        {
+            position->color_data[captured_color].has_upper_rook_moved = true;
+        }
+    }
+    position->hash ^= _chesscat_castling_key(position);
+
+    _chesscat_move_packed_pieces(position, move, undo);
+
+    position->hash ^= _chesscat_passant_key(position);
+    position->passant_target_square = none;
+    position->passantable_square = none;
+    if ((move & CHESSCAT_MOVE_DOUBLE_PUSH_FLAG) && position->game_rules.allow_passant)
+    {
+        chesscat_Square passant = {.row = (from.row + to.row) / 2, .col = (from.col + to.col) / 2};
+        position->passantable_square = passant;
+        position->passant_target_square = to;
+    }
+    position->hash ^= _chesscat_passant_key(position);
+    // TODO: Do Captured_Pieces here
+    // TODO: Do Num_Checks here
+    _chesscat_set_next_to_play(position);
+}
+
+/*
+ * chesscat_make_move
+ *
+ * Plays a move in the given position, setting all positional data as required
+ */
+void chesscat_make_move(chesscat_Position *position, chesscat_Move move, chesscat_EPieceType pawn_promotion)
+{
+    _chesscat_make_packed_move(position, chesscat_encode_move(position, move, pawn_promotion), NULL);
+}
+
+/*
+ * chesscat_do_move
+ *
+ * Plays a packed move like chesscat_make_move, saving what it changes to undo so that chesscat_undo_move can take it back.
+ * Only the written squares, castling flags, en passant squares, color to play and hash are saved
+ */
+void chesscat_do_move(chesscat_Position *position, chesscat_PackedMove move, chesscat_MoveUndo *undo)
+{
+    undo->num_squares = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        undo->color_data[color] = position->color_data[color];
+    }
+    undo->passantable_square = position->passantable_square;
+    undo->passant_target_square = position->passant_target_square;
+    undo->to_move = position->to_move;
+    undo->hash = position->hash;
+    _chesscat_make_packed_move(position, move, undo);
+}
+
+/*
+ * chesscat_undo_move
+ *
+ * Takes back a move played with chesscat_do_move. Moves must be undone in the reverse order they were done
+ */
+void chesscat_undo_move(chesscat_Position *position, chesscat_MoveUndo *undo)
+{
+    for (int8_t i = undo->num_squares - 1; i >= 0; i--)
+    {
+        chesscat_set_piece_at_square(position, undo->squares[i], undo->pieces[i]);
+    }
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        position->color_data[color] = undo->color_data[color];
+    }
+    position->passantable_square = undo->passantable_square;
+    position->passant_target_square = undo->passant_target_square;
+    position->to_move = undo->to_move;
+    position->hash = undo->hash;
+}
+
+
+bool chesscat_is_position_check(chesscat_Position *position){
+    if(_chesscat_position_ignores_checks(position)){
+        return false;
+    }
+    chesscat_Bitboard royals;
+    _chesscat_bitboard_intersect(&royals, &(position->royal_occupancy), &(position->color_occupancy[position->to_move]));
+    uint16_t index;
+    while((index = _chesscat_bitboard_pop_first(&royals)) != CHESSCAT_NUM_SQUARES){
+        if(_chesscat_is_square_attacked_by_opponents(position, _chesscat_index_square(index), position->to_move)){
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * _chesscat_move_gives_check
+ *
+ * Returns whether playing a move attacks a royal piece of another color still in the game
+ */
+bool _chesscat_move_gives_check(chesscat_Position *position, chesscat_PackedMove move)
+{
+    chesscat_EColor color = position->to_move;
+    chesscat_MoveUndo undo;
+    chesscat_do_move(position, move, &undo);
+
+    bool gives_check = false;
+    for (uint8_t other = 0; other < CHESSCAT_NUM_COLORS && !gives_check; other++)
+    {
+        if (other == color || !position->color_data[other].is_in_game)
+        {
+            continue;
+        }
+        chesscat_Bitboard royals;
+        _chesscat_bitboard_intersect(&royals, &(position->royal_occupancy), &(position->color_occupancy[other]));
+        uint16_t index;
+        while (!gives_check && (index = _chesscat_bitboard_pop_first(&royals)) != CHESSCAT_NUM_SQUARES)
+        {
+            gives_check = chesscat_is_square_attacked(position, _chesscat_index_square(index), color);
+        }
+    }
+
+    chesscat_undo_move(position, &undo);
+    return gives_check;
+}
+
+/*
+ * _chesscat_keep_checks
+ *
+ * Removes the moves that do not give check from a list of moves, keeping the order of the rest. Returns the new count
+ */
+uint16_t _chesscat_keep_checks(chesscat_Position *position, chesscat_PackedMove moves[], uint16_t num_moves)
+{
+    uint16_t num_checks = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        if (_chesscat_move_gives_check(position, moves[i]))
+        {
+            moves[num_checks++] = moves[i];
+        }
+    }
+    return num_checks;
+}
+
+/*
+ * chesscat_generate_moves_from
+ *
+ * Writes the possible (not necessarily legal) moves of the given mode from the given square for the current color to play
+ * to moves_buf as packed moves, with one move per promotion piece. moves_buf needs room for CHESSCAT_MAX_MOVES_FROM_SQUARE moves.
+ * Targets come from the board size's precomputed geometry tables, so no bounds are checked while generating.
+ * Each mode only walks the parts of the generator that can produce its moves
+ */
+uint16_t chesscat_generate_moves_from(chesscat_Position *position, chesscat_Square square, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[])
+{
+
+    bool moves_like_bishop = false;
+    bool moves_like_rook = false;
+    bool moves_like_knight = false;
+    bool moves_like_king = false;
+    bool moves_like_pawn = false;
+
+    chesscat_Piece piece = chesscat_get_piece_at_square(position, square);
+
+    if (piece.color != position->to_move || piece.type == Empty)
+    {
+        return 0;
+    }
+    if (mode == GenerateChecks)
+    {
+        uint16_t num_quiets = chesscat_generate_moves_from(position, square, GenerateQuiets, moves_buf);
+        return _chesscat_keep_checks(position, moves_buf, num_quiets);
+    }
+    if (position->game_rules.use_mailbox)
+    {
+        return _chesscat_generate_moves_from_mailbox(position, square, mode, moves_buf);
+    }
+
+    chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+    if (geometry == NULL)
+    {
+        return 0;
+    }
+    uint16_t index = _chesscat_square_index(square);
+    bool wants_captures = _chesscat_mode_wants(mode, true);
+    bool wants_quiets = _chesscat_mode_wants(mode, false);
+
+    uint16_t num_moves = 0;
+
+    switch (piece.type)
+    {
+    case Pawn:
+        moves_like_pawn = true;
+        break;
+    case King:
+        moves_like_king = true;
+        break;
+    case Queen:
+        moves_like_bishop = true;
+        moves_like_rook = true;
+        break;
+    case Rook:
+        moves_like_rook = true;
+        break;
+    case Knight:
+        moves_like_knight = true;
+        break;
+    case Bishop:
+        moves_like_bishop = true;
+        break;
+    default:
+        break;
+    }
+
+    if (moves_like_king || moves_like_knight)
+    {
+        uint8_t num_targets = moves_like_king ? geometry->num_king_targets[index] : geometry->num_knight_targets[index];
+        chesscat_Square *targets = moves_like_king ? geometry->king_targets[index] : geometry->knight_targets[index];
+        for (uint8_t i = 0; i < num_targets; i++)
+        {
+            chesscat_Piece target_piece = chesscat_get_piece_at_square(position, targets[i]);
+            if ((target_piece.type == Empty ? wants_quiets : wants_captures) && _chesscat_color_can_capture_piece(position, piece.color, target_piece))
+            {
+                _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(index, _chesscat_square_index(targets[i]), piece.type, target_piece.type, Empty, 0));
+            }
+        }
+        if (moves_like_king && wants_quiets)
+        {
+            _chesscat_add_castle_moves(position, square, piece, moves_buf, &num_moves);
+        }
+    }
+    if (moves_like_bishop || moves_like_rook)
+    {
+        uint8_t first_ray = moves_like_bishop ? 0 : 4;
+        uint8_t last_ray = moves_like_rook ? 8 : 4;
+        for (uint8_t ray = first_ray; ray < last_ray; ray++)
+        {
+            chesscat_Square tosquare = square;
+            for (uint8_t step = 0; step < geometry->ray_lengths[index][ray]; step++)
+            {
+                tosquare.row += _chesscat_ray_steps[ray][0];
+                tosquare.col += _chesscat_ray_steps[ray][1];
+                chesscat_Piece hit_piece = chesscat_get_piece_at_square(position, tosquare);
+                if (hit_piece.type == Empty)
+                {
+                    if (wants_quiets)
+                    {
+                        _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(index, _chesscat_square_index(tosquare), piece.type, Empty, Empty, 0));
+                    }
+                    continue;
+                }
+                if (wants_captures && _chesscat_color_can_capture_piece(position, piece.color, hit_piece))
+                {
+                    _chesscat_add_packed_move(moves_buf, &num_moves, chesscat_pack_move(index, _chesscat_square_index(tosquare), piece.type, hit_piece.type, Empty, 0));
+                }
+                break;
+            }
+        }
+    }
+    if (moves_like_pawn)
+    {
+        chesscat_Square advance_square = geometry->pawn_push[piece.color][index];
+
+        if (chesscat_is_valid_square(advance_square))
+        {
+            chesscat_Square double_advance_square = geometry->pawn_double_push[piece.color][index];
+
+            if (_chesscat_pawn_pushes_wanted(position, piece.color, advance_square, double_advance_square, mode))
+            {
+                chesscat_Piece advance_piece = chesscat_get_piece_at_square(position, advance_square);
+                if (advance_piece.type == Empty)
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, advance_square, Empty, 0, mode, moves_buf, &num_moves);
+                    if ((position->game_rules.torpedo_pawns || geometry->pawn_on_start_rank[piece.color][index]) &&
+                        chesscat_is_valid_square(double_advance_square) &&
+                        chesscat_get_piece_at_square(position, double_advance_square).type == Empty)
+                    {
+                        _chesscat_add_pawn_move(position, piece.color, square, double_advance_square, Empty, CHESSCAT_MOVE_DOUBLE_PUSH_FLAG, mode, moves_buf, &num_moves);
+                    }
+                }
+                else if (position->game_rules.kangaroo_pawns && chesscat_is_valid_square(double_advance_square) &&
+                         chesscat_get_piece_at_square(position, double_advance_square).type == Empty)
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, double_advance_square, Empty, CHESSCAT_MOVE_DOUBLE_PUSH_FLAG, mode, moves_buf, &num_moves);
+                }
+            }
+            for (uint8_t i = 0; i < geometry->num_pawn_captures[piece.color][index] && wants_captures; i++)
+            {
+                chesscat_Square take_square = geometry->pawn_captures[piece.color][index][i];
+                chesscat_Piece take_piece = chesscat_get_piece_at_square(position, take_square);
+                if (take_piece.type != Empty && _chesscat_color_can_capture_piece(position, piece.color, take_piece))
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, take_square, take_piece.type, 0, mode, moves_buf, &num_moves);
+                }
+                else if (take_piece.type == Empty && _chesscat_same_squares(take_square, position->passantable_square))
+                {
+                    chesscat_EPieceType captured = chesscat_get_piece_at_square(position, position->passant_target_square).type;
+                    _chesscat_add_pawn_move(position, piece.color, square, take_square, captured, CHESSCAT_MOVE_PASSANT_FLAG, mode, moves_buf, &num_moves);
+                }
+            }
+        }
+
+        if (position->game_rules.sideways_pawns)
+        {
+            for (uint8_t i = 0; i < geometry->num_pawn_sideways[piece.color][index]; i++)
+            {
+                chesscat_Square side_square = geometry->pawn_sideways[piece.color][index][i];
+                chesscat_Piece side_piece = chesscat_get_piece_at_square(position, side_square);
+                if (_chesscat_color_can_capture_piece(position, piece.color, side_piece))
+                {
+                    _chesscat_add_pawn_move(position, piece.color, square, side_square, side_piece.type, 0, mode, moves_buf, &num_moves);
+                }
+            }
+        }
+    }
+
+    return num_moves;
+}
+
+/*
+ * _chesscat_add_packed_moves
+ *
+ * Counts a square's packed moves, copying them to moves_buf while there is room. See _chesscat_add_move_to_buf
+ */
+void _chesscat_add_packed_moves(chesscat_PackedMove moves[], uint16_t count, chesscat_PackedMove moves_buf[], uint16_t max_moves, uint16_t *num_moves)
+{
+    for (uint16_t i = 0; i < count && *num_moves + i < max_moves; i++)
+    {
+        moves_buf[*num_moves + i] = moves[i];
+    }
+    *num_moves += count;
+}
+
+/*
+ * _chesscat_has_room_for_square
+ *
+ * Returns whether a square's moves can be generated straight into a buffer holding num_moves of max_moves moves
+ */
+bool _chesscat_has_room_for_square(uint16_t max_moves, uint16_t num_moves)
+{
+    return num_moves <= max_moves && max_moves - num_moves >= CHESSCAT_MAX_MOVES_FROM_SQUARE;
+}
+
+/*
+ * chesscat_generate_moves
+ *
+ * Writes up to max_moves possible (not necessarily legal) moves of the given mode for the current color to play to
+ * moves_buf as packed moves, in a single pass. Returns the number of moves found, which is more than max_moves if
+ * moves_buf overflowed. A buffer of chesscat_get_max_moves moves is always large enough
+ */
+uint16_t chesscat_generate_moves(chesscat_Position *position, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[], uint16_t max_moves)
+{
+    uint16_t move_count = 0;
+    uint16_t num_pieces = position->piece_count[position->to_move];
+    uint16_t *pieces = position->piece_list[position->to_move];
+    uint16_t pieces_copy[CHESSCAT_NUM_SQUARES];
+    if (mode == GenerateChecks)
+    { // Finding checks plays and takes back moves, which can reorder the piece list
+        memcpy(pieces_copy, pieces, num_pieces * sizeof(uint16_t));
+        pieces = pieces_copy;
+    }
+    for (uint16_t i = 0; i < num_pieces; i++)
+    {
+        chesscat_Square square = _chesscat_index_square(pieces[i]);
+        if (_chesscat_has_room_for_square(max_moves, move_count))
+        {
+            move_count += chesscat_generate_moves_from(position, square, mode, moves_buf + move_count);
+            continue;
+        }
+        chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        uint16_t num_moves = chesscat_generate_moves_from(position, square, mode, moves);
+        _chesscat_add_packed_moves(moves, num_moves, moves_buf, max_moves, &move_count);
+    }
+    return move_count;
+}
+
+/*
+ * _chesscat_add_unpacked_moves
+ *
+ * Adds packed moves to an unpacked move buffer. Unpacked moves carry no promotion piece, so only queen
+ * promotions are kept
+ */
+void _chesscat_add_unpacked_moves(chesscat_PackedMove packed[], uint16_t num_packed, chesscat_Move moves_buf[], uint16_t max_moves, uint16_t *num_moves)
+{
+    for (uint16_t i = 0; i < num_packed; i++)
+    {
+        chesscat_EPieceType promotion = chesscat_packed_move_promotion(packed[i]);
+        if (promotion != Empty && promotion != Queen)
+        {
+            continue;
+        }
+        _chesscat_add_move_to_buf(chesscat_unpack_move(packed[i]), moves_buf, max_moves, num_moves);
+    }
+}
+
+/*
+ * chesscat_get_possible_moves_from
+ *
+ * Writes all possible (not necessarily legal) moves from the given square for the current color to play to moves_buf,
+ * which needs room for CHESSCAT_MAX_MOVES_FROM_SQUARE moves
+ */
+uint16_t chesscat_get_possible_moves_from(chesscat_Position *position, chesscat_Square square, chesscat_Move moves_buf[])
+{
+    chesscat_PackedMove packed[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+    uint16_t num_packed = chesscat_generate_moves_from(position, square, GenerateAll, packed);
+    uint16_t num_moves = 0;
+    _chesscat_add_unpacked_moves(packed, num_packed, moves_buf, CHESSCAT_MAX_MOVES_FROM_SQUARE, &num_moves);
+    return num_moves;
+}
+
+/*
+ * chesscat_get_all_possible_moves
+ *
+ * Writes up to max_moves possible (not necessarily legal) moves for the current color to play to moves_buf, in a single pass.
+ * Returns the number of moves found, which is more than max_moves if moves_buf overflowed
+ */
+uint16_t chesscat_get_all_possible_moves(chesscat_Position *position, chesscat_Move moves_buf[], uint16_t max_moves)
+{
+    uint16_t move_count = 0;
+    uint16_t num_pieces = position->piece_count[position->to_move];
+    for (uint16_t i = 0; i < num_pieces; i++)
+    {
+        chesscat_Square square = _chesscat_index_square(position->piece_list[position->to_move][i]);
+        chesscat_PackedMove packed[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        uint16_t num_packed = chesscat_generate_moves_from(position, square, GenerateAll, packed);
+        _chesscat_add_unpacked_moves(packed, num_packed, moves_buf, max_moves, &move_count);
+    }
+    return move_count;
+}
+
+/*
+ * _chesscat_get_possible_moves_to
+ *
+ * Writes the possible (not necessarily legal) moves landing on the given square to moves_buf,
+ * which needs room for CHESSCAT_MAX_MOVES_TO_SQUARE moves
+ */
+uint16_t _chesscat_get_possible_moves_to(chesscat_Position *position, chesscat_Square to, chesscat_Move moves_buf[])
+{
+    uint16_t move_count = 0;
+    uint16_t to_index = _chesscat_square_index(to);
+    uint16_t num_pieces = position->piece_count[position->to_move];
+    for (uint16_t i = 0; i < num_pieces; i++)
+    {
+        chesscat_Square square = _chesscat_index_square(position->piece_list[position->to_move][i]);
+        chesscat_PackedMove packed[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        uint16_t num_packed = chesscat_generate_moves_from(position, square, GenerateAll, packed);
+        for (uint16_t j = 0; j < num_packed; j++)
+        {
+            chesscat_EPieceType promotion = chesscat_packed_move_promotion(packed[j]);
+            if (chesscat_packed_move_to(packed[j]) == to_index && (promotion == Empty || promotion == Queen))
+            {
+                _chesscat_add_move_to_buf(chesscat_unpack_move(packed[j]), moves_buf, CHESSCAT_MAX_MOVES_TO_SQUARE, &move_count);
+            }
+        }
+    }
+    return move_count;
+}
+
+/*
+ * _chesscat_packed_move_into_check
+ *
+ * Returns whether the given packed move moves into check in the given position
+ */
+bool _chesscat_packed_move_into_check(chesscat_Position *position, chesscat_PackedMove move)
+{
+    if (_chesscat_position_ignores_checks(position))
+    {
+        return false;
+    }
+
+    chesscat_MoveUndo undo;
+    chesscat_do_move(position, move, &undo);
+
+    bool into_check = _chesscat_can_royal_be_captured(position);
+
+    chesscat_undo_move(position, &undo);
+    return into_check;
+}
+
+/*
+ * chesscat_moves_into_check
+ *
+ * Returns whether the given move moves into check in the given position
+ */
+bool chesscat_moves_into_check(chesscat_Position *position, chesscat_Move move)
+{
+    return _chesscat_packed_move_into_check(position, chesscat_encode_move(position, move, Empty));
+}
+
+/*
+ * _chesscat_is_packed_move_legal
+ *
+ * Returns whether the given packed move is legal in the given position. Castles may not start in or pass through check
+ * Does not check if a move is actually *possible* - assumes it is
+ */
+bool _chesscat_is_packed_move_legal(chesscat_Position *position, chesscat_PackedMove move)
+{
+    if (_chesscat_packed_move_into_check(position, move))
+    {
+        return false;
+    }
+    if (move & CHESSCAT_MOVE_CASTLE_FLAG)
+    {
+        if (chesscat_is_position_check(position))
+        {
+            return false;
+        }
+        chesscat_Square from = _chesscat_index_square(chesscat_packed_move_from(move));
+        chesscat_Square to = _chesscat_index_square(chesscat_packed_move_to(move));
+        chesscat_Square castle_step_square = {.row = from.row + (to.row > from.row) - (to.row < from.row),
+                                              .col = from.col + (to.col > from.col) - (to.col < from.col)};
+        if (!_chesscat_position_ignores_checks(position) &&
+            _chesscat_is_square_attacked_by_opponents(position, castle_step_square, position->to_move))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * chesscat_is_move_legal
+ *
+ * Returns whether the given move is legal in the given position
+ * Does not check if a move is actually *possible* - assumes it is
+ */
+bool chesscat_is_move_legal(chesscat_Position *position, chesscat_Move move, chesscat_EPieceType promotion)
+{ // Check if a move meets qualifications to be legal. Does not check if it is POSSIBLE
+    chesscat_Piece moving = chesscat_get_piece_at_square(position, move.from);
+    if (moving.type == Pawn && _chesscat_square_on_promotion_rank(position, move.to, position->to_move))
+    {
+        // Promotes
+        if (promotion == King || promotion == Empty)
+        {
+            return false;
+        }
+    }
+    return _chesscat_is_packed_move_legal(position, chesscat_encode_move(position, move, promotion));
+}
+
+bool chesscat_is_move_possible(chesscat_Position *position, chesscat_Move move){
+    chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+    uint16_t num_moves = chesscat_generate_moves_from(position, move.from, GenerateAll, moves);
+    uint16_t to_index = _chesscat_square_index(move.to);
+
+    for(uint16_t i = 0; i < num_moves; i++){
+        if(chesscat_packed_move_to(moves[i]) == to_index){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * _chesscat_get_legality_info
+ *
+ * Finds the checkers of and the pieces pinned to the color to play's royal piece, so that most moves can be
+ * tested for legality without playing them. Only enabled for check-enforcing positions where the color to
+ * play has a single royal piece and pieces cannot capture their own color (a friendly capture could open a line)
+ */
+void _chesscat_get_legality_info(chesscat_Position *position, _chesscat_LegalityInfo *info)
+{
+    static const int8_t rays[8][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}, {1, 0}, {0, -1}, {-1, 0}, {0, 1}};
+
+    chesscat_EColor color = position->to_move;
+    info->enabled = false;
+    info->num_checkers = 0;
+    info->num_pins = 0;
+    if (_chesscat_position_ignores_checks(position) || position->game_rules.capture_own || position->royal_count[color] != 1)
+    {
+        return;
+    }
+    chesscat_Bitboard royals;
+    _chesscat_bitboard_intersect(&royals, &(position->royal_occupancy), &(position->color_occupancy[color]));
+    info->royal_square = _chesscat_index_square(_chesscat_bitboard_first(&royals));
+    info->enabled = true;
+
+    chesscat_Square checkers[2];
+    for (uint8_t other = 0; other < CHESSCAT_NUM_COLORS && info->num_checkers < 2; other++)
+    {
+        if (other == color || !position->color_data[other].is_in_game)
+        {
+            continue;
+        }
+        info->num_checkers += _chesscat_find_attackers(position, info->royal_square, other, checkers + info->num_checkers, 2 - info->num_checkers);
+    }
+
+    _chesscat_bitboard_clear_all(&(info->check_mask));
+    if (info->num_checkers == 1)
+    { // Capture the checker, or block it if it checks from along a line
+        chesscat_Square checker = checkers[0];
+        _chesscat_bitboard_set(&(info->check_mask), _chesscat_square_index(checker));
+        int8_t row_dif = checker.row - info->royal_square.row;
+        int8_t col_dif = checker.col - info->royal_square.col;
+        if (row_dif == 0 || col_dif == 0 || abs(row_dif) == abs(col_dif))
+        {
+            int8_t row_step = (row_dif > 0) - (row_dif < 0);
+            int8_t col_step = (col_dif > 0) - (col_dif < 0);
+            chesscat_Square between = {.row = info->royal_square.row + row_step, .col = info->royal_square.col + col_step};
+            while (!_chesscat_same_squares(between, checker))
+            {
+                _chesscat_bitboard_set(&(info->check_mask), _chesscat_square_index(between));
+                between.row += row_step;
+                between.col += col_step;
+            }
+        }
+    }
+
+    for (uint8_t ray = 0; ray < 8; ray++)
+    {
+        bool diagonal = ray < 4;
+        chesscat_Square checking = {.row = info->royal_square.row + rays[ray][0], .col = info->royal_square.col + rays[ray][1]};
+        chesscat_Square blocker = {.row = -1, .col = -1};
+        while (chesscat_square_in_bounds(position, checking))
+        {
+            chesscat_Piece hit = chesscat_get_piece_at_square(position, checking);
+            if (hit.type != Empty)
+            {
+                if (!chesscat_is_valid_square(blocker))
+                {
+                    if (hit.color != color)
+                    {
+                        break;
+                    }
+                    blocker = checking;
+                }
+                else
+                {
+                    if (hit.color != color && position->color_data[hit.color].is_in_game &&
+                        (hit.type == Queen || (diagonal && hit.type == Bishop) || (!diagonal && hit.type == Rook)))
+                    {
+                        info->pinned[info->num_pins] = blocker;
+                        info->pinners[info->num_pins] = checking;
+                        info->pin_row_step[info->num_pins] = rays[ray][0];
+                        info->pin_col_step[info->num_pins] = rays[ray][1];
+                        info->num_pins++;
+                    }
+                    break;
+                }
+            }
+            checking.row += rays[ray][0];
+            checking.col += rays[ray][1];
+        }
+    }
+}
+
+/*
+ * _chesscat_is_pseudo_move_legal
+ *
+ * Returns whether a possible packed move is legal using precomputed legality info.
+ * Royal moves, castles and en passants are played and tested instead, since they can uncover attacks
+ */
+bool _chesscat_is_pseudo_move_legal(chesscat_Position *position, _chesscat_LegalityInfo *info, chesscat_PackedMove move)
+{
+    if (!info->enabled || (move & (CHESSCAT_MOVE_CASTLE_FLAG | CHESSCAT_MOVE_PASSANT_FLAG)))
+    {
+        return _chesscat_is_packed_move_legal(position, move);
+    }
+    chesscat_Square from = _chesscat_index_square(chesscat_packed_move_from(move));
+    if (_chesscat_same_squares(from, info->royal_square))
+    {
+        return _chesscat_is_packed_move_legal(position, move);
+    }
+    if (info->num_checkers > 1)
+    {
+        return false;
+    }
+    if (info->num_checkers == 1 && !_chesscat_bitboard_test(&(info->check_mask), chesscat_packed_move_to(move)))
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < info->num_pins; i++)
+    {
+        if (_chesscat_same_squares(info->pinned[i], from))
+        { // A pinned piece may only move along the line from the royal piece up to and onto its pinner. Kangaroo pawns could jump past it
+            chesscat_Square to = _chesscat_index_square(chesscat_packed_move_to(move));
+            int8_t row_dif = to.row - info->royal_square.row;
+            int8_t col_dif = to.col - info->royal_square.col;
+            int8_t distance = abs(row_dif) > abs(col_dif) ? abs(row_dif) : abs(col_dif);
+            int8_t pin_distance = abs(info->pinners[i].row - info->royal_square.row) > abs(info->pinners[i].col - info->royal_square.col) ?
+                                  abs(info->pinners[i].row - info->royal_square.row) : abs(info->pinners[i].col - info->royal_square.col);
+            return row_dif == distance * info->pin_row_step[i] && col_dif == distance * info->pin_col_step[i] && distance <= pin_distance;
+        }
+    }
+    return true;
+}
+
+/*
+ * _chesscat_generate_legal_moves_from
+ *
+ * Writes the legal packed moves from a square to moves_buf, filtering its possible moves with precomputed legality info
+ */
+uint16_t _chesscat_generate_legal_moves_from(chesscat_Position *position, _chesscat_LegalityInfo *info, chesscat_Square from, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[]){
+    chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+    uint16_t num_possible_moves = chesscat_generate_moves_from(position, from, mode, moves);
+    uint16_t num_legal_moves = 0;
+    for(uint16_t i = 0; i < num_possible_moves; i++){
+        if(_chesscat_is_pseudo_move_legal(position, info, moves[i])){
+            _chesscat_add_packed_move(moves_buf, &num_legal_moves, moves[i]);
+        }
+    }
+    return num_legal_moves;
+}
+
+/*
+ * chesscat_generate_legal_moves
+ *
+ * Writes up to max_moves legal moves of the given mode for the current color to play to moves_buf as packed moves, with one
+ * move per promotion piece. Returns the number of moves found, which is more than max_moves if moves_buf overflowed.
+ * Checkers and pins are found once, then each piece's possible moves are filtered in a single pass
+ */
+uint16_t chesscat_generate_legal_moves(chesscat_Position *position, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[], uint16_t max_moves){
+    _chesscat_LegalityInfo info;
+    _chesscat_get_legality_info(position, &info);
+
+    uint16_t num_legal_moves = 0;
+    chesscat_EColor color = position->to_move;
+
+    // Testing a move plays and takes it back, which can reorder the piece list, so walk a copy of it
+    uint16_t num_pieces = position->piece_count[color];
+    uint16_t pieces[CHESSCAT_NUM_SQUARES];
+    memcpy(pieces, position->piece_list[color], num_pieces * sizeof(uint16_t));
+
+    for(uint16_t i = 0; i < num_pieces; i++){
+        chesscat_Square from = _chesscat_index_square(pieces[i]);
+        if(info.enabled && info.num_checkers > 1 && !_chesscat_same_squares(from, info.royal_square)){
+            continue; // Only the royal piece can escape a double check
+        }
+        if(_chesscat_has_room_for_square(max_moves, num_legal_moves)){
+            num_legal_moves += _chesscat_generate_legal_moves_from(position, &info, from, mode, moves_buf + num_legal_moves);
+            continue;
+        }
+        chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        uint16_t num_moves = _chesscat_generate_legal_moves_from(position, &info, from, mode, moves);
+        _chesscat_add_packed_moves(moves, num_moves, moves_buf, max_moves, &num_legal_moves);
+    }
+    return num_legal_moves;
+}
+
+/*
+ * _chesscat_has_legal_move
+ *
+ * Returns whether the color to play has any legal move, stopping at the first piece that has one
+ */
+bool _chesscat_has_legal_move(chesscat_Position *position){
+    _chesscat_LegalityInfo info;
+    _chesscat_get_legality_info(position, &info);
+
+    chesscat_EColor color = position->to_move;
+    uint16_t num_pieces = position->piece_count[color];
+    uint16_t pieces[CHESSCAT_NUM_SQUARES];
+    memcpy(pieces, position->piece_list[color], num_pieces * sizeof(uint16_t));
+
+    for(uint16_t i = 0; i < num_pieces; i++){
+        chesscat_Square from = _chesscat_index_square(pieces[i]);
+        if(info.enabled && info.num_checkers > 1 && !_chesscat_same_squares(from, info.royal_square)){
+            continue;
+        }
+        chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        if(_chesscat_generate_legal_moves_from(position, &info, from, GenerateAll, moves) > 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * _chesscat_count_free_moves_from
+ *
+ * Counts the moves of a knight or slider without writing them, reading its targets from the geometry tables.
+ * Only moves landing on mask are counted if mask is not NULL. Assumes every counted move is legal
+ */
+uint16_t _chesscat_count_free_moves_from(chesscat_Position *position, chesscat_Geometry *geometry, uint16_t index, chesscat_Piece piece, chesscat_Bitboard *mask)
+{
+    uint16_t num_moves = 0;
+    if (piece.type == Knight)
+    {
+        for (uint8_t i = 0; i < geometry->num_knight_targets[index]; i++)
+        {
+            chesscat_Square target = geometry->knight_targets[index][i];
+            if (_chesscat_color_can_capture_piece(position, piece.color, chesscat_get_piece_at_square(position, target)) &&
+                (mask == NULL || _chesscat_bitboard_test(mask, _chesscat_square_index(target))))
+            {
+                num_moves++;
+            }
+        }
+        return num_moves;
+    }
+    uint8_t first_ray = piece.type == Rook ? 4 : 0;
+    uint8_t last_ray = piece.type == Bishop ? 4 : 8;
+    chesscat_Square square = _chesscat_index_square(index);
+    for (uint8_t ray = first_ray; ray < last_ray; ray++)
+    {
+        chesscat_Square tosquare = square;
+        for (uint8_t step = 0; step < geometry->ray_lengths[index][ray]; step++)
+        {
+            tosquare.row += _chesscat_ray_steps[ray][0];
+            tosquare.col += _chesscat_ray_steps[ray][1];
+            chesscat_Piece hit_piece = chesscat_get_piece_at_square(position, tosquare);
+            if (hit_piece.type == Empty || _chesscat_color_can_capture_piece(position, piece.color, hit_piece))
+            {
+                if (mask == NULL || _chesscat_bitboard_test(mask, _chesscat_square_index(tosquare)))
+                {
+                    num_moves++;
+                }
+            }
+            if (hit_piece.type != Empty)
+            {
+                break;
+            }
+        }
+    }
+    return num_moves;
+}
+
+/*
+ * chesscat_count_legal_moves
+ *
+ * Returns the number of legal moves for the current color to play, counting promotions once per promotion piece.
+ * Unpinned knights and sliders are counted straight from the geometry tables using the position's checkers and pins.
+ * Other pieces, and positions where the legality info is disabled by the rules, fall back to generating the piece's
+ * moves and testing each one
+ */
+uint16_t chesscat_count_legal_moves(chesscat_Position *position)
+{
+    _chesscat_LegalityInfo info;
+    _chesscat_get_legality_info(position, &info);
+
+    chesscat_Geometry *geometry = position->game_rules.use_mailbox ? NULL : _chesscat_position_geometry(position);
+    chesscat_Bitboard *mask = info.num_checkers == 1 ? &(info.check_mask) : NULL;
+    uint16_t num_legal_moves = 0;
+    chesscat_EColor color = position->to_move;
+
+    uint16_t num_pieces = position->piece_count[color];
+    uint16_t pieces[CHESSCAT_NUM_SQUARES];
+    memcpy(pieces, position->piece_list[color], num_pieces * sizeof(uint16_t));
+
+    for(uint16_t i = 0; i < num_pieces; i++){
+        chesscat_Square from = _chesscat_index_square(pieces[i]);
+        chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+        if(info.enabled && !_chesscat_same_squares(from, info.royal_square)){
+            if(info.num_checkers > 1){
+                continue;
+            }
+            bool pinned = false;
+            for(uint8_t pin = 0; pin < info.num_pins && !pinned; pin++){
+                pinned = _chesscat_same_squares(info.pinned[pin], from);
+            }
+            if(!pinned && geometry != NULL &&
+               (piece.type == Knight || piece.type == Bishop || piece.type == Rook || piece.type == Queen)){
+                num_legal_moves += _chesscat_count_free_moves_from(position, geometry, pieces[i], piece, mask);
+                continue;
+            }
+        }
+        chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        num_legal_moves += _chesscat_generate_legal_moves_from(position, &info, from, GenerateAll, moves);
+    }
+    return num_legal_moves;
+}
+
+/*
+ * chesscat_generate_legal_moves_from
+ *
+ * Writes the legal moves of the given mode from the given square to moves_buf as packed moves
+ */
+uint16_t chesscat_generate_legal_moves_from(chesscat_Position *position, chesscat_Square from, chesscat_EGenerationMode mode, chesscat_PackedMove moves_buf[]){
+    _chesscat_LegalityInfo info;
+    _chesscat_get_legality_info(position, &info);
+    return _chesscat_generate_legal_moves_from(position, &info, from, mode, moves_buf);
+}
+
+/*
+ * chesscat_get_all_legal_moves
+ *
+ * Writes up to max_moves legal moves for the current color to play to moves_buf, in a single pass. Promotions are listed once.
+ * Returns the number of moves found, which is more than max_moves if moves_buf overflowed
+ */
+uint16_t chesscat_get_all_legal_moves(chesscat_Position *position, chesscat_Move moves_buf[], uint16_t max_moves){
+    _chesscat_LegalityInfo info;
+    _chesscat_get_legality_info(position, &info);
+
+    uint16_t num_legal_moves = 0;
+    chesscat_EColor color = position->to_move;
+
+    uint16_t num_pieces = position->piece_count[color];
+    uint16_t pieces[CHESSCAT_NUM_SQUARES];
+    memcpy(pieces, position->piece_list[color], num_pieces * sizeof(uint16_t));
+
+    for(uint16_t i = 0; i < num_pieces; i++){
+        chesscat_Square from = _chesscat_index_square(pieces[i]);
+        if(info.enabled && info.num_checkers > 1 && !_chesscat_same_squares(from, info.royal_square)){
+            continue;
+        }
+        chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+        uint16_t num_moves = _chesscat_generate_legal_moves_from(position, &info, from, GenerateAll, moves);
+        _chesscat_add_unpacked_moves(moves, num_moves, moves_buf, max_moves, &num_legal_moves);
+    }
+    return num_legal_moves;
+}
+
+/*
+ * chesscat_get_legal_moves_from
+ *
+ * Writes the legal moves from the given square to moves_buf, which needs room for CHESSCAT_MAX_MOVES_FROM_SQUARE moves
+ */
+uint16_t chesscat_get_legal_moves_from(chesscat_Position *position, chesscat_Square from, chesscat_Move moves_buf[]){
+    chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+    uint16_t num_moves = chesscat_generate_legal_moves_from(position, from, GenerateAll, moves);
+    uint16_t num_legal_moves = 0;
+    _chesscat_add_unpacked_moves(moves, num_moves, moves_buf, CHESSCAT_MAX_MOVES_FROM_SQUARE, &num_legal_moves);
+    return num_legal_moves;
+}
+
+chesscat_EPositionState chesscat_get_current_state(chesscat_Position *position){
+    bool isCheck = chesscat_is_position_check(position);
+
+    bool noLegalMoves = !_chesscat_has_legal_move(position);
+
+    if(_chesscat_position_ignores_checks(position)){
+        if(position->game_rules.capture_all){
+            if(_chesscat_count_pieces(position, position->to_move) == 0){
+                return Checkmated;
+            }
+            else if(noLegalMoves){
+                return Stalemated;
+            }
+        }
+        else if(!_chesscat_has_royal(position, position->to_move)){
+            return Checkmated;
+        }
+    }
+    else{
+        if(noLegalMoves && isCheck){
+            return Checkmated;
+        }
+        if(noLegalMoves){
+            return Stalemated;
+        }
+        if(isCheck){
+            return Checked;
+        }
+    }
+    //TODO: Add lack of material draws
+    return Normal;
+}
+
+/*   Static exchange evaluation functions   */
+
+int16_t _chesscat_see_attacker_rank(chesscat_Piece piece)
+{ // Attackers are used cheapest first, and royal pieces only last
+    return piece.is_royal ? INT16_MAX : _chesscat_piece_values[piece.type];
+}
+
+bool _chesscat_see_is_on_side(chesscat_Position *position, chesscat_EColor piece_color, chesscat_EColor color, bool coalition)
+{ // Whether a piece belongs to one side of an exchange: color alone, or every other color still in the game
+    if (coalition)
+    {
+        return piece_color != color && position->color_data[piece_color].is_in_game;
+    }
+    return piece_color == color;
+}
+
+/*
+ * _chesscat_see_consider
+ *
+ * Keeps the piece on from as the least valuable attacker found so far if it belongs to the side and may capture occupant
+ */
+void _chesscat_see_consider(chesscat_Position *position, chesscat_Square from, chesscat_Piece occupant, chesscat_EColor color, bool coalition, uint16_t *best, int16_t *best_rank)
+{
+    chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+    if (!_chesscat_see_is_on_side(position, piece.color, color, coalition) || !_chesscat_color_can_capture_piece(position, piece.color, occupant))
+    {
+        return;
+    }
+    int16_t rank = _chesscat_see_attacker_rank(piece);
+    if (*best == CHESSCAT_NUM_SQUARES || rank < *best_rank)
+    {
+        *best = _chesscat_square_index(from);
+        *best_rank = rank;
+    }
+}
+
+/*
+ * _chesscat_see_least_attacker
+ *
+ * Returns the square index of the least valuable piece that could capture occupant on square for one side of an
+ * exchange, or CHESSCAT_NUM_SQUARES if there is none. Pieces on squares in removed have already been traded off and
+ * are skipped, uncovering any slider behind them. Pawns capture along their own color's direction, and sideways too
+ * under sideways_pawns
+ */
+uint16_t _chesscat_see_least_attacker(chesscat_Position *position, chesscat_Geometry *geometry, chesscat_Square square, chesscat_Piece occupant, chesscat_EColor color, bool coalition, chesscat_Bitboard *removed)
+{
+    uint16_t index = _chesscat_square_index(square);
+    uint16_t best = CHESSCAT_NUM_SQUARES;
+    int16_t best_rank = 0;
+    for (uint8_t i = 0; i < geometry->num_knight_targets[index]; i++)
+    {
+        chesscat_Square from = geometry->knight_targets[index][i];
+        if (chesscat_get_piece_at_square(position, from).type == Knight && !_chesscat_bitboard_test(removed, _chesscat_square_index(from)))
+        {
+            _chesscat_see_consider(position, from, occupant, color, coalition, &best, &best_rank);
+        }
+    }
+    for (uint8_t i = 0; i < geometry->num_king_targets[index]; i++)
+    {
+        chesscat_Square from = geometry->king_targets[index][i];
+        if (chesscat_get_piece_at_square(position, from).type == King && !_chesscat_bitboard_test(removed, _chesscat_square_index(from)))
+        {
+            _chesscat_see_consider(position, from, occupant, color, coalition, &best, &best_rank);
+        }
+    }
+    for (uint8_t ray = 0; ray < 8; ray++)
+    {
+        bool diagonal = ray < 4;
+        chesscat_Square checking = square;
+        for (uint8_t step = 0; step < geometry->ray_lengths[index][ray]; step++)
+        {
+            checking.row += _chesscat_ray_steps[ray][0];
+            checking.col += _chesscat_ray_steps[ray][1];
+            chesscat_Piece hit = chesscat_get_piece_at_square(position, checking);
+            if (hit.type == Empty || _chesscat_bitboard_test(removed, _chesscat_square_index(checking)))
+            {
+                continue;
+            }
+            if (hit.type == Queen || (diagonal && hit.type == Bishop) || (!diagonal && hit.type == Rook))
+            {
+                _chesscat_see_consider(position, checking, occupant, color, coalition, &best, &best_rank);
+            }
+            break;
+        }
+    }
+    for (uint8_t pawn_color = 0; pawn_color < CHESSCAT_NUM_COLORS; pawn_color++)
+    {
+        if (!_chesscat_see_is_on_side(position, pawn_color, color, coalition))
+        {
+            continue;
+        }
+        for (uint8_t i = 0; i < geometry->num_pawn_attackers[pawn_color][index]; i++)
+        {
+            chesscat_Square from = geometry->pawn_attackers[pawn_color][index][i];
+            chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+            if (piece.type == Pawn && piece.color == pawn_color && !_chesscat_bitboard_test(removed, _chesscat_square_index(from)))
+            {
+                _chesscat_see_consider(position, from, occupant, color, coalition, &best, &best_rank);
+            }
+        }
+        if (!position->game_rules.sideways_pawns)
+        {
+            continue;
+        }
+        for (uint8_t i = 0; i < geometry->num_pawn_sideways[pawn_color][index]; i++)
+        {
+            chesscat_Square from = geometry->pawn_sideways[pawn_color][index][i];
+            chesscat_Piece piece = chesscat_get_piece_at_square(position, from);
+            if (piece.type == Pawn && piece.color == pawn_color && !_chesscat_bitboard_test(removed, _chesscat_square_index(from)))
+            {
+                _chesscat_see_consider(position, from, occupant, color, coalition, &best, &best_rank);
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * chesscat_see
+ *
+ * Static exchange evaluation: returns the material in centipawns the color to play can expect to gain with a move
+ * once every capture on its destination has been played out, each side recapturing with its least valuable piece
+ * and either side free to stop when going on would lose more. Sliders behind pieces that have been traded off join in.
+ * The other colors still in the game recapture as one coalition, which is how the mover should fear them when they
+ * all play against it. Capturing a friendly piece under capture_own costs its value, and recaptures follow the game
+ * rules through _chesscat_color_can_capture_piece. A royal piece only recaptures when nothing can take it back.
+ * Quiet moves score what the piece risks by moving to its destination, 0 or less
+ */
+int16_t chesscat_see(chesscat_Position *position, chesscat_PackedMove move)
+{
+    chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+    if (geometry == NULL)
+    {
+        return 0;
+    }
+    chesscat_Square from = _chesscat_index_square(chesscat_packed_move_from(move));
+    chesscat_Square to = _chesscat_index_square(chesscat_packed_move_to(move));
+    chesscat_EColor color = position->to_move;
+    chesscat_Piece occupant = chesscat_get_piece_at_square(position, from);
+    chesscat_Piece victim = chesscat_get_piece_at_square(position, to);
+
+    int16_t gains[CHESSCAT_SEE_MAX_EXCHANGES];
+    if (move & CHESSCAT_MOVE_PASSANT_FLAG)
+    {
+        gains[0] = _chesscat_piece_values[Pawn];
+    }
+    else
+    {
+        gains[0] = victim.color == color ? -_chesscat_piece_value(victim) : _chesscat_piece_value(victim);
+    }
+    int16_t occupant_value = _chesscat_piece_value(occupant);
+    if (chesscat_packed_move_promotion(move) != Empty)
+    {
+        occupant.type = chesscat_packed_move_promotion(move);
+        gains[0] += _chesscat_piece_values[occupant.type] - occupant_value;
+        occupant_value = _chesscat_piece_values[occupant.type];
+    }
+
+    chesscat_Bitboard removed;
+    _chesscat_bitboard_clear_all(&removed);
+    _chesscat_bitboard_set(&removed, chesscat_packed_move_from(move));
+    bool coalition = true; // Side to recapture next
+    uint8_t depth = 0;
+    while (depth + 1 < CHESSCAT_SEE_MAX_EXCHANGES)
+    {
+        uint16_t attacker = _chesscat_see_least_attacker(position, geometry, to, occupant, color, coalition, &removed);
+        if (attacker == CHESSCAT_NUM_SQUARES)
+        {
+            break;
+        }
+        chesscat_Piece piece = chesscat_get_piece_at_square(position, _chesscat_index_square(attacker));
+        _chesscat_bitboard_set(&removed, attacker);
+        if (piece.is_royal &&
+            _chesscat_see_least_attacker(position, geometry, to, piece, color, !coalition, &removed) != CHESSCAT_NUM_SQUARES)
+        { // The royal piece would be captured back
+            break;
+        }
+        int16_t gain = occupant_value - gains[depth];
+        if ((gain > -gains[depth] ? gain : -gains[depth]) < 0)
+        { // This side loses out whether it captures or not, so the exchange ends here either way
+            break;
+        }
+        gains[++depth] = gain;
+        occupant = piece;
+        occupant_value = _chesscat_piece_value(piece);
+        coalition = !coalition;
+    }
+    while (depth > 0)
+    {
+        depth--;
+        gains[depth] = -(-gains[depth] > gains[depth + 1] ? -gains[depth] : gains[depth + 1]);
+    }
+    return gains[0];
+}
+
+/*   Move ordering functions   */
+
+static const int8_t _chesscat_piece_order_values[CHESSCAT_NUM_PIECE_TYPES] = {0, 1, 10, 9, 5, 3, 3}; //Rough values in pawns, by chesscat_EPieceType
+
+/*
+ * _chesscat_move_order_score
+ *
+ * Scores a capture or promotion for ordering: the most valuable victim and promotion first, then the least valuable attacker
+ */
+int16_t _chesscat_move_order_score(chesscat_PackedMove move)
+{
+    int16_t gain = _chesscat_piece_order_values[chesscat_packed_move_captured(move)] + _chesscat_piece_order_values[chesscat_packed_move_promotion(move)];
+    return gain * 16 - _chesscat_piece_order_values[chesscat_packed_move_piece(move)];
+}
+
+bool _chesscat_is_quiet_move(chesscat_PackedMove move)
+{
+    return chesscat_packed_move_captured(move) == Empty && chesscat_packed_move_promotion(move) == Empty;
+}
+
+/*
+ * _chesscat_ordering_score
+ *
+ * Scores any move for ordering: captures and promotions by _chesscat_move_order_score, above every quiet move,
+ * and quiet moves by their history if ordering is not NULL
+ */
+int32_t _chesscat_ordering_score(chesscat_MoveOrdering *ordering, chesscat_PackedMove move)
+{
+    if (!_chesscat_is_quiet_move(move))
+    {
+        return CHESSCAT_HISTORY_MAX + 1 + _chesscat_move_order_score(move);
+    }
+    return ordering != NULL ? ordering->history[chesscat_packed_move_from(move)][chesscat_packed_move_to(move)] : 0;
+}
+
+void chesscat_clear_move_ordering(chesscat_MoveOrdering *ordering)
+{
+    memset(ordering, 0, sizeof(chesscat_MoveOrdering));
+}
+
+/*
+ * _chesscat_history_bonus
+ *
+ * Adds bonus, which may be negative, to a history score. The more extreme the score already is, the less it moves,
+ * so scores stay within CHESSCAT_HISTORY_MAX and recent cutoffs outweigh old ones
+ */
+void _chesscat_history_bonus(int16_t *history, int16_t bonus)
+{
+    *history += bonus - *history * abs(bonus) / CHESSCAT_HISTORY_MAX;
+}
+
+/*
+ * chesscat_record_cutoff
+ *
+ * Learns from a beta cutoff caused by move, the move_number-th move searched at a node reached by previous_move
+ * (CHESSCAT_NO_MOVE at the root), depth plies from the horizon. A quiet move gains history and becomes the counter
+ * move to previous_move, and the quiet moves tried before it lose history
+ */
+void chesscat_record_cutoff(chesscat_MoveOrdering *ordering, chesscat_PackedMove move, chesscat_PackedMove previous_move, chesscat_PackedMove quiets_tried[], uint16_t num_quiets_tried, uint8_t depth, uint16_t move_number)
+{
+    ordering->cutoffs++;
+    if (move_number == 0)
+    {
+        ordering->first_move_cutoffs++;
+    }
+    if (!_chesscat_is_quiet_move(move))
+    {
+        return;
+    }
+    int16_t bonus = depth * depth < CHESSCAT_HISTORY_MAX / 16 ? depth * depth : CHESSCAT_HISTORY_MAX / 16;
+    _chesscat_history_bonus(&(ordering->history[chesscat_packed_move_from(move)][chesscat_packed_move_to(move)]), bonus);
+    for (uint16_t i = 0; i < num_quiets_tried; i++)
+    {
+        if (quiets_tried[i] != move)
+        {
+            _chesscat_history_bonus(&(ordering->history[chesscat_packed_move_from(quiets_tried[i])][chesscat_packed_move_to(quiets_tried[i])]), -bonus);
+        }
+    }
+    if (previous_move != CHESSCAT_NO_MOVE)
+    {
+        ordering->counter_moves[chesscat_packed_move_from(previous_move)][chesscat_packed_move_to(previous_move)] = move;
+    }
+}
+
+/*
+ * chesscat_order_moves
+ *
+ * Sorts moves from any of the generators best first: captures and promotions by most valuable victim and least
+ * valuable attacker, then quiet moves by history if ordering is not NULL. Equal moves keep their generation order
+ */
+void chesscat_order_moves(chesscat_MoveOrdering *ordering, chesscat_PackedMove moves[], uint16_t num_moves)
+{
+    for (uint16_t i = 1; i < num_moves; i++)
+    {
+        chesscat_PackedMove move = moves[i];
+        int32_t score = _chesscat_ordering_score(ordering, move);
+        uint16_t j = i;
+        while (j > 0 && _chesscat_ordering_score(ordering, moves[j - 1]) < score)
+        {
+            moves[j] = moves[j - 1];
+            j--;
+        }
+        moves[j] = move;
+    }
+}
+
+/*   Move picker functions   */
+
+/*
+ * _chesscat_is_good_capture
+ *
+ * Returns whether a capture is expected not to lose material: it takes another color's piece worth at least the
+ * capturing piece, or its exchange is not lost by chesscat_see
+ */
+bool _chesscat_is_good_capture(chesscat_Position *position, chesscat_PackedMove move)
+{
+    chesscat_Piece victim = chesscat_get_piece_at_square(position, _chesscat_index_square(chesscat_packed_move_to(move)));
+    if (victim.color != position->to_move &&
+        _chesscat_piece_order_values[chesscat_packed_move_captured(move)] >= _chesscat_piece_order_values[chesscat_packed_move_piece(move)])
+    {
+        return true;
+    }
+    return chesscat_see(position, move) >= 0;
+}
+
+/*
+ * chesscat_init_move_picker
+ *
+ * Sets up a move picker, which hands out the legal moves of a position one at a time through chesscat_pick_move:
+ * the hash move, winning captures, promotions, killer moves, the counter move, quiet moves and finally losing captures.
+ * Captures are only generated once the hash move has been tried, and quiet moves once the killers have been,
+ * into moves_buf, which should hold chesscat_get_max_moves moves.
+ * hash_move may be CHESSCAT_NO_MOVE and killers may be NULL. The position must be the same whenever a move is picked
+ */
+void chesscat_init_move_picker(chesscat_MovePicker *picker, chesscat_Position *position, chesscat_PackedMove moves_buf[], uint16_t max_moves, chesscat_PackedMove hash_move, chesscat_PackedMove killers[])
+{
+    picker->position = position;
+    picker->stage = PickHashMove;
+    picker->hash_move = hash_move;
+    for (uint8_t i = 0; i < CHESSCAT_NUM_KILLERS; i++)
+    {
+        picker->killers[i] = killers != NULL ? killers[i] : CHESSCAT_NO_MOVE;
+    }
+    picker->killer_index = 0;
+    picker->ordering = NULL;
+    picker->counter_move = CHESSCAT_NO_MOVE;
+    picker->captures_only = false;
+    picker->moves = moves_buf;
+    picker->max_moves = max_moves;
+    picker->num_moves = 0;
+    picker->current = 0;
+    picker->captures_end = 0;
+    picker->promotions_end = 0;
+    picker->bad_captures_end = 0;
+    _chesscat_get_legality_info(position, &(picker->info));
+}
+
+/*
+ * chesscat_init_capture_picker
+ *
+ * Sets up a move picker that only hands out winning captures and promotions, best first, for quiescence search
+ */
+void chesscat_init_capture_picker(chesscat_MovePicker *picker, chesscat_Position *position, chesscat_PackedMove moves_buf[], uint16_t max_moves)
+{
+    chesscat_init_move_picker(picker, position, moves_buf, max_moves, CHESSCAT_NO_MOVE, NULL);
+    picker->captures_only = true;
+}
+
+/*
+ * chesscat_set_picker_ordering
+ *
+ * Has a move picker hand out quiet moves by ordering's history, and try the counter move to previous_move right after
+ * the killers. previous_move may be CHESSCAT_NO_MOVE. Call before picking the first move
+ */
+void chesscat_set_picker_ordering(chesscat_MovePicker *picker, chesscat_MoveOrdering *ordering, chesscat_PackedMove previous_move)
+{
+    picker->ordering = ordering;
+    if (previous_move != CHESSCAT_NO_MOVE)
+    {
+        picker->counter_move = ordering->counter_moves[chesscat_packed_move_from(previous_move)][chesscat_packed_move_to(previous_move)];
+    }
+}
+
+/*
+ * _chesscat_picker_is_move_valid
+ *
+ * Returns whether a move of the given mode, such as a hash or killer move from a different position, is a legal move here.
+ * Only the moves from its square are generated to check
+ */
+bool _chesscat_picker_is_move_valid(chesscat_MovePicker *picker, chesscat_PackedMove move, chesscat_EGenerationMode mode)
+{
+    chesscat_PackedMove moves[CHESSCAT_MAX_MOVES_FROM_SQUARE];
+    uint16_t num_moves = chesscat_generate_moves_from(picker->position, _chesscat_index_square(chesscat_packed_move_from(move)), mode, moves);
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        if (moves[i] == move)
+        {
+            return _chesscat_is_pseudo_move_legal(picker->position, &(picker->info), move);
+        }
+    }
+    return false;
+}
+
+/*
+ * _chesscat_picker_generate_captures
+ *
+ * Generates the picker's captures and promotions, and sorts them into captures, then promotions
+ */
+void _chesscat_picker_generate_captures(chesscat_MovePicker *picker)
+{
+    chesscat_PackedMove *moves = picker->moves;
+    uint16_t num_moves = chesscat_generate_moves(picker->position, GenerateCaptures, moves, picker->max_moves);
+    if (num_moves > picker->max_moves)
+    {
+        num_moves = picker->max_moves;
+    }
+    uint16_t captures_end = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        if (chesscat_packed_move_captured(moves[i]) != Empty && chesscat_packed_move_promotion(moves[i]) == Empty)
+        {
+            chesscat_PackedMove swap = moves[captures_end];
+            moves[captures_end++] = moves[i];
+            moves[i] = swap;
+        }
+    }
+    uint16_t promotions_end = captures_end;
+    for (uint16_t i = captures_end; i < num_moves; i++)
+    {
+        if (chesscat_packed_move_promotion(moves[i]) != Empty)
+        {
+            chesscat_PackedMove swap = moves[promotions_end];
+            moves[promotions_end++] = moves[i];
+            moves[i] = swap;
+        }
+    }
+    picker->num_moves = num_moves;
+    picker->captures_end = captures_end;
+    picker->promotions_end = promotions_end;
+}
+
+/*
+ * _chesscat_picker_generate_quiets
+ *
+ * Generates the picker's quiet moves after its captures and promotions
+ */
+void _chesscat_picker_generate_quiets(chesscat_MovePicker *picker)
+{
+    uint16_t room = picker->max_moves - picker->promotions_end;
+    uint16_t num_quiets = chesscat_generate_moves(picker->position, GenerateQuiets, picker->moves + picker->promotions_end, room);
+    if (num_quiets > room)
+    {
+        num_quiets = room;
+    }
+    picker->num_moves = picker->promotions_end + num_quiets;
+}
+
+/*
+ * _chesscat_picker_select_best
+ *
+ * Moves the best scoring move left before end to the picker's current slot and returns it, like one step of a selection sort
+ */
+chesscat_PackedMove _chesscat_picker_select_best(chesscat_MovePicker *picker, uint16_t end)
+{
+    chesscat_PackedMove *moves = picker->moves;
+    uint16_t best = picker->current;
+    int32_t best_score = _chesscat_ordering_score(picker->ordering, moves[best]);
+    for (uint16_t i = picker->current + 1; i < end; i++)
+    {
+        int32_t score = _chesscat_ordering_score(picker->ordering, moves[i]);
+        if (score > best_score)
+        {
+            best = i;
+            best_score = score;
+        }
+    }
+    chesscat_PackedMove move = moves[best];
+    moves[best] = moves[picker->current];
+    moves[picker->current] = move;
+    picker->current++;
+    return move;
+}
+
+bool _chesscat_picker_is_killer(chesscat_MovePicker *picker, chesscat_PackedMove move)
+{
+    for (uint8_t i = 0; i < CHESSCAT_NUM_KILLERS; i++)
+    {
+        if (picker->killers[i] == move)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * chesscat_pick_move
+ *
+ * Returns the picker's next legal move, or CHESSCAT_NO_MOVE once every move has been picked.
+ * Each stage is only worked through when the previous one runs out, so stopping early skips the rest
+ */
+chesscat_PackedMove chesscat_pick_move(chesscat_MovePicker *picker)
+{
+    chesscat_Position *position = picker->position;
+    while (true)
+    {
+        switch (picker->stage)
+        {
+        case PickHashMove:
+            picker->stage = PickGenerateCaptures;
+            if (picker->hash_move != CHESSCAT_NO_MOVE && _chesscat_picker_is_move_valid(picker, picker->hash_move, GenerateAll))
+            {
+                return picker->hash_move;
+            }
+            break;
+        case PickGenerateCaptures:
+            _chesscat_picker_generate_captures(picker);
+            picker->stage = PickGoodCaptures;
+            break;
+        case PickGoodCaptures:
+            while (picker->current < picker->captures_end)
+            {
+                chesscat_PackedMove move = _chesscat_picker_select_best(picker, picker->captures_end);
+                if (move == picker->hash_move)
+                {
+                    continue;
+                }
+                if (!_chesscat_is_good_capture(position, move))
+                { // Save it for last. Everything before current has been picked, so there is room
+                    picker->moves[picker->bad_captures_end++] = move;
+                    continue;
+                }
+                if (_chesscat_is_pseudo_move_legal(position, &(picker->info), move))
+                {
+                    return move;
+                }
+            }
+            picker->stage = PickPromotions;
+            break;
+        case PickPromotions:
+            while (picker->current < picker->promotions_end)
+            {
+                chesscat_PackedMove move = _chesscat_picker_select_best(picker, picker->promotions_end);
+                if (move != picker->hash_move && _chesscat_is_pseudo_move_legal(position, &(picker->info), move))
+                {
+                    return move;
+                }
+            }
+            picker->stage = picker->captures_only ? PickDone : PickKillers;
+            break;
+        case PickKillers:
+            while (picker->killer_index < CHESSCAT_NUM_KILLERS)
+            {
+                chesscat_PackedMove killer = picker->killers[picker->killer_index++];
+                if (killer == CHESSCAT_NO_MOVE || killer == picker->hash_move)
+                {
+                    continue;
+                }
+                bool repeated = false;
+                for (uint8_t i = 0; i + 1 < picker->killer_index; i++)
+                {
+                    repeated = repeated || picker->killers[i] == killer;
+                }
+                if (!repeated && _chesscat_picker_is_move_valid(picker, killer, GenerateQuiets))
+                {
+                    return killer;
+                }
+            }
+            picker->stage = PickCounterMove;
+            break;
+        case PickCounterMove:
+            picker->stage = PickGenerateQuiets;
+            if (picker->counter_move != CHESSCAT_NO_MOVE && picker->counter_move != picker->hash_move &&
+                !_chesscat_picker_is_killer(picker, picker->counter_move) && _chesscat_picker_is_move_valid(picker, picker->counter_move, GenerateQuiets))
+            {
+                return picker->counter_move;
+            }
+            break;
+        case PickGenerateQuiets:
+            _chesscat_picker_generate_quiets(picker);
+            picker->stage = PickQuiets;
+            break;
+        case PickQuiets:
+            while (picker->current < picker->num_moves)
+            {
+                chesscat_PackedMove move = picker->ordering != NULL ? _chesscat_picker_select_best(picker, picker->num_moves) : picker->moves[picker->current++];
+                if (move != picker->hash_move && move != picker->counter_move && !_chesscat_picker_is_killer(picker, move) &&
+                    _chesscat_is_pseudo_move_legal(position, &(picker->info), move))
+                {
+                    return move;
+                }
+            }
+            picker->stage = PickBadCaptures;
+            picker->current = 0;
+            break;
+        case PickBadCaptures:
+            while (picker->current < picker->bad_captures_end)
+            {
+                chesscat_PackedMove move = picker->moves[picker->current++];
+                if (_chesscat_is_pseudo_move_legal(position, &(picker->info), move))
+                {
+                    return move;
                 }
             }
+            picker->stage = PickDone;
+            break;
+        default:
+            return CHESSCAT_NO_MOVE;
+        }
+    }
+}
+
+/*   Transposition table functions   */
+
+/*
+ * _chesscat_tt_alloc
+ *
+ * Allocates size bytes of cache-line-aligned clusters for a table. With use_huge_pages on Linux, explicit huge pages are
+ * tried first, then a normal mapping advised to use transparent huge pages. Returns whether memory was allocated
+ */
+bool _chesscat_tt_alloc(chesscat_TranspositionTable *tt, size_t size, bool use_huge_pages)
+{
+    tt->is_mapped = false;
+    tt->uses_huge_pages = false;
+    tt->size = size;
+#ifdef CHESSCAT_HAS_MMAP
+    if (use_huge_pages)
+    {
+        size_t mapped_size = (size + CHESSCAT_TT_HUGE_PAGE_SIZE - 1) & ~((size_t)CHESSCAT_TT_HUGE_PAGE_SIZE - 1);
+        void *memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            tt->uses_huge_pages = true;
+        }
+        else
+        {
+            memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+            {
+                return false;
+            }
+            tt->uses_huge_pages = madvise(memory, mapped_size, MADV_HUGEPAGE) == 0;
+        }
+        tt->clusters = memory;
+        tt->size = mapped_size;
+        tt->is_mapped = true;
+        return true;
+    }
+#else
+    (void)use_huge_pages;
+#endif
+    tt->clusters = aligned_alloc(sizeof(_chesscat_TTCluster), size);
+    return tt->clusters != NULL;
+}
+
+/*
+ * chesscat_tt_clear
+ *
+ * Empties a table and restarts its generation count. Probe statistics are kept by each caller in its own chesscat_TTStats
+ * and are not touched. Not thread-safe: no other thread may use the table meanwhile
+ */
+void chesscat_tt_clear(chesscat_TranspositionTable *tt)
+{
+    memset(tt->clusters, 0, tt->num_clusters * sizeof(_chesscat_TTCluster));
+    tt->generation = 0;
+}
+
+/*
+ * chesscat_tt_init
+ *
+ * Allocates a transposition table of at most size_mb megabytes, rounded down to a power of two clusters, and clears it.
+ * Returns false if the memory cannot be allocated. Free the table with chesscat_tt_free
+ */
+bool chesscat_tt_init(chesscat_TranspositionTable *tt, size_t size_mb, bool use_huge_pages)
+{
+    uint64_t num_clusters = 1;
+    while ((num_clusters * 2) * sizeof(_chesscat_TTCluster) <= (uint64_t)size_mb * 1024 * 1024)
+    {
+        num_clusters *= 2;
+    }
+    tt->clusters = NULL;
+    tt->num_clusters = 0;
+    if (!_chesscat_tt_alloc(tt, num_clusters * sizeof(_chesscat_TTCluster), use_huge_pages))
+    {
+        tt->clusters = NULL;
+        return false;
+    }
+    tt->num_clusters = num_clusters;
+    chesscat_tt_clear(tt);
+    return true;
+}
+
+void chesscat_tt_free(chesscat_TranspositionTable *tt)
+{
+    if (tt->clusters == NULL)
+    {
+        return;
+    }
+#ifdef CHESSCAT_HAS_MMAP
+    if (tt->is_mapped)
+    {
+        munmap(tt->clusters, tt->size);
+    }
+    else
+    {
+        free(tt->clusters);
+    }
+#else
+    free(tt->clusters);
+#endif
+    tt->clusters = NULL;
+    tt->num_clusters = 0;
+}
+
+/*
+ * chesscat_tt_new_search
+ *
+ * Marks the start of a new search, so that entries left from earlier searches are replaced before current ones
+ */
+void chesscat_tt_new_search(chesscat_TranspositionTable *tt)
+{
+    tt->generation = (tt->generation + 1) & ((1 << CHESSCAT_TT_GENERATION_BITS) - 1);
+}
+
+_chesscat_TTCluster *_chesscat_tt_cluster(chesscat_TranspositionTable *tt, uint64_t key)
+{
+    return &(tt->clusters[key & (tt->num_clusters - 1)]);
+}
+
+uint8_t _chesscat_tt_data_depth(uint64_t data)
+{
+    return (data >> CHESSCAT_TT_DEPTH_SHIFT) & 0xFF;
+}
+
+chesscat_EBound _chesscat_tt_data_bound(uint64_t data)
+{
+    return (data >> CHESSCAT_TT_BOUND_SHIFT) & 0x3;
+}
+
+uint8_t _chesscat_tt_data_age(chesscat_TranspositionTable *tt, uint64_t data)
+{
+    uint8_t generation = (data >> CHESSCAT_TT_GENERATION_SHIFT) & ((1 << CHESSCAT_TT_GENERATION_BITS) - 1);
+    return (tt->generation - generation) & ((1 << CHESSCAT_TT_GENERATION_BITS) - 1);
+}
+
+/*
+ * _chesscat_tt_find
+ *
+ * Looks for the entry with the given key, setting data to it if found, and counts the probe in stats if it is not NULL.
+ * Each slot is read with two relaxed atomic loads, so a slot being written by another thread either matches entirely or not at all
+ */
+bool _chesscat_tt_find(chesscat_TranspositionTable *tt, uint64_t key, uint64_t *data, chesscat_TTStats *stats)
+{
+    _chesscat_TTCluster *cluster = _chesscat_tt_cluster(tt, key);
+    bool found = false;
+    for (uint8_t i = 0; i < CHESSCAT_TT_CLUSTER_SIZE; i++)
+    {
+        uint64_t slot_data = __atomic_load_n(&(cluster->slots[i].data), __ATOMIC_RELAXED);
+        uint64_t key_xor_data = __atomic_load_n(&(cluster->slots[i].key_xor_data), __ATOMIC_RELAXED);
+        if ((key_xor_data ^ slot_data) == key && _chesscat_tt_data_bound(slot_data) != BoundNone)
+        {
+            *data = slot_data;
+            found = true;
+            break;
+        }
+    }
+    if (stats != NULL)
+    {
+        stats->probes++;
+        stats->hits += found;
+    }
+    return found;
+}
+
+/*
+ * _chesscat_tt_write
+ *
+ * Stores data under a key. An entry with the same key is overwritten, keeping its move if keep_move is set and data has none.
+ * Otherwise the data goes to the depth-preferred slot holding the shallowest or oldest entry, unless that entry is
+ * from the current search and deeper, in which case the always-replace slot is used
+ */
+void _chesscat_tt_write(chesscat_TranspositionTable *tt, uint64_t key, uint64_t data, bool keep_move)
+{
+    _chesscat_TTCluster *cluster = _chesscat_tt_cluster(tt, key);
+    _chesscat_TTSlot *replace = NULL;
+    for (uint8_t i = 0; i < CHESSCAT_TT_CLUSTER_SIZE; i++)
+    {
+        uint64_t slot_data = __atomic_load_n(&(cluster->slots[i].data), __ATOMIC_RELAXED);
+        uint64_t key_xor_data = __atomic_load_n(&(cluster->slots[i].key_xor_data), __ATOMIC_RELAXED);
+        if ((key_xor_data ^ slot_data) == key && _chesscat_tt_data_bound(slot_data) != BoundNone)
+        {
+            replace = &(cluster->slots[i]);
+            if (keep_move && (data >> CHESSCAT_TT_MOVE_SHIFT) == CHESSCAT_NO_MOVE)
+            {
+                data |= slot_data & ((uint64_t)0xFFFFFFFF << CHESSCAT_TT_MOVE_SHIFT);
+            }
+            break;
+        }
+    }
+    if (replace == NULL)
+    {
+        int16_t lowest_value = INT16_MAX;
+        uint64_t lowest_data = 0;
+        for (uint8_t i = 0; i < CHESSCAT_TT_DEPTH_SLOTS; i++)
+        {
+            uint64_t slot_data = __atomic_load_n(&(cluster->slots[i].data), __ATOMIC_RELAXED);
+            int16_t value = _chesscat_tt_data_bound(slot_data) == BoundNone ? INT16_MIN : _chesscat_tt_data_depth(slot_data) - 8 * _chesscat_tt_data_age(tt, slot_data);
+            if (value < lowest_value)
+            {
+                lowest_value = value;
+                lowest_data = slot_data;
+                replace = &(cluster->slots[i]);
+            }
+        }
+        if (_chesscat_tt_data_bound(lowest_data) != BoundNone && _chesscat_tt_data_age(tt, lowest_data) == 0 &&
+            _chesscat_tt_data_depth(data) < _chesscat_tt_data_depth(lowest_data))
+        {
+            replace = &(cluster->slots[CHESSCAT_TT_CLUSTER_SIZE - 1]);
+        }
+    }
+    __atomic_store_n(&(replace->data), data, __ATOMIC_RELAXED);
+    __atomic_store_n(&(replace->key_xor_data), key ^ data, __ATOMIC_RELAXED);
+}
+
+/*
+ * chesscat_tt_probe
+ *
+ * Looks up a position's hash, setting entry and returning true if the table holds a search result for it.
+ * The probe is counted in stats, the calling thread's own, if it is not NULL.
+ * Safe to call from many threads at once, along with chesscat_tt_store
+ */
+bool chesscat_tt_probe(chesscat_TranspositionTable *tt, uint64_t hash, chesscat_TTEntry *entry, chesscat_TTStats *stats)
+{
+    uint64_t data;
+    if (!_chesscat_tt_find(tt, hash, &data, stats))
+    {
+        return false;
+    }
+    entry->move = data >> CHESSCAT_TT_MOVE_SHIFT;
+    entry->score = (int16_t)(data >> CHESSCAT_TT_SCORE_SHIFT);
+    entry->depth = _chesscat_tt_data_depth(data);
+    entry->bound = _chesscat_tt_data_bound(data);
+    return true;
+}
+
+/*
+ * chesscat_tt_store
+ *
+ * Stores a search result for a position's hash. If the position is already stored with a move and move is
+ * CHESSCAT_NO_MOVE, the old move is kept. Safe to call from many threads at once
+ */
+void chesscat_tt_store(chesscat_TranspositionTable *tt, uint64_t hash, chesscat_PackedMove move, int16_t score, uint8_t depth, chesscat_EBound bound)
+{
+    uint64_t data = ((uint64_t)depth << CHESSCAT_TT_DEPTH_SHIFT) |
+                    ((uint64_t)bound << CHESSCAT_TT_BOUND_SHIFT) |
+                    ((uint64_t)tt->generation << CHESSCAT_TT_GENERATION_SHIFT) |
+                    ((uint64_t)(uint16_t)score << CHESSCAT_TT_SCORE_SHIFT) |
+                    ((uint64_t)move << CHESSCAT_TT_MOVE_SHIFT);
+    _chesscat_tt_write(tt, hash, data, true);
+}
+
+/*
+ * chesscat_tt_probe_perft
+ *
+ * Looks up the perft leaf count of a position's hash at the given depth, setting nodes and returning true if stored.
+ * Perft counts are keyed by depth, so they never match search results or counts for other depths.
+ * The probe is counted in stats if it is not NULL
+ */
+bool chesscat_tt_probe_perft(chesscat_TranspositionTable *tt, uint64_t hash, uint8_t depth, uint64_t *nodes, chesscat_TTStats *stats)
+{
+    uint64_t data;
+    if (!_chesscat_tt_find(tt, hash ^ _chesscat_zobrist_keys.perft_depth[depth], &data, stats))
+    {
+        return false;
+    }
+    *nodes = data >> CHESSCAT_TT_NODES_SHIFT;
+    return true;
+}
+
+/*
+ * chesscat_tt_store_perft
+ *
+ * Stores the perft leaf count of a position's hash at the given depth. Counts too large to store are skipped
+ */
+void chesscat_tt_store_perft(chesscat_TranspositionTable *tt, uint64_t hash, uint8_t depth, uint64_t nodes)
+{
+    if (nodes > CHESSCAT_TT_MAX_NODES)
+    {
+        return;
+    }
+    uint64_t data = ((uint64_t)depth << CHESSCAT_TT_DEPTH_SHIFT) |
+                    ((uint64_t)BoundExact << CHESSCAT_TT_BOUND_SHIFT) |
+                    ((uint64_t)tt->generation << CHESSCAT_TT_GENERATION_SHIFT) |
+                    (nodes << CHESSCAT_TT_NODES_SHIFT);
+    _chesscat_tt_write(tt, hash ^ _chesscat_zobrist_keys.perft_depth[depth], data, false);
+}
+
+/*
+ * chesscat_tt_hit_rate
+ *
+ * Returns the fraction of the probes counted in stats that found an entry. Add up each thread's stats first
+ */
+double chesscat_tt_hit_rate(chesscat_TTStats *stats)
+{
+    if (stats->probes == 0)
+    {
+        return 0;
+    }
+    return (double)stats->hits / stats->probes;
+}
+
+/*
+ * chesscat_tt_fill_permille
+ *
+ * Returns how many of every thousand slots hold an entry, sampled from the first clusters of the table
+ */
+uint16_t chesscat_tt_fill_permille(chesscat_TranspositionTable *tt)
+{
+    uint64_t num_sampled = tt->num_clusters < CHESSCAT_TT_FILL_SAMPLE ? tt->num_clusters : CHESSCAT_TT_FILL_SAMPLE;
+    uint64_t num_filled = 0;
+    for (uint64_t i = 0; i < num_sampled; i++)
+    {
+        for (uint8_t j = 0; j < CHESSCAT_TT_CLUSTER_SIZE; j++)
+        {
+            if (_chesscat_tt_data_bound(__atomic_load_n(&(tt->clusters[i].slots[j].data), __ATOMIC_RELAXED)) != BoundNone)
+            {
+                num_filled++;
+            }
+        }
+    }
+    return num_filled * 1000 / (num_sampled * CHESSCAT_TT_CLUSTER_SIZE);
+}
+
+/*   Perft functions   */
+
+/*
+ * _chesscat_perft
+ *
+ * Counts leaf nodes as chesscat_perft does, generating each ply's moves into the next max_moves moves of move_stack
+ */
+uint64_t _chesscat_perft(chesscat_Position *position, uint8_t depth, chesscat_TranspositionTable *tt, chesscat_TTStats *stats, chesscat_PackedMove move_stack[], uint16_t max_moves)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    uint64_t nodes = 0;
+    if (tt != NULL && depth > 1 && chesscat_tt_probe_perft(tt, position->hash, depth, &nodes, stats))
+    {
+        return nodes;
+    }
+    if (depth == 1)
+    { // Leaves only need counting, not generating
+        return chesscat_count_legal_moves(position);
+    }
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, move_stack, max_moves);
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, move_stack[i], &undo);
+        nodes += _chesscat_perft(position, depth - 1, tt, stats, move_stack + max_moves, max_moves);
+        chesscat_undo_move(position, &undo);
+    }
+    if (tt != NULL)
+    {
+        chesscat_tt_store_perft(tt, position->hash, depth, nodes);
+    }
+    return nodes;
+}
+
+/*
+ * chesscat_perft
+ *
+ * Counts the leaf nodes of the legal move tree to the given depth. tt may be NULL; otherwise subtree counts
+ * are looked up in it and stored to it, and the probes counted in stats if it is not NULL. Moves are generated
+ * into move_stack, which holds depth buffers of chesscat_get_max_moves moves, one per ply, so threads counting
+ * many trees can each keep their own. If move_stack is NULL, one is allocated for the call. Returns 0 if the
+ * rules allow no moves or memory ran out
+ */
+uint64_t chesscat_perft(chesscat_Position *position, uint8_t depth, chesscat_TranspositionTable *tt, chesscat_TTStats *stats, chesscat_PackedMove move_stack[])
+{
+    uint16_t max_moves = chesscat_get_max_moves(&(position->game_rules));
+    if (max_moves == 0)
+    {
+        return 0;
+    }
+    if (move_stack != NULL || depth <= 1)
+    {
+        return _chesscat_perft(position, depth, tt, stats, move_stack, max_moves);
+    }
+    chesscat_PackedMove *own_stack = malloc((size_t)depth * max_moves * sizeof(chesscat_PackedMove));
+    if (own_stack == NULL)
+    {
+        return 0;
+    }
+    uint64_t nodes = _chesscat_perft(position, depth, tt, stats, own_stack, max_moves);
+    free(own_stack);
+    return nodes;
+}
+
+/*
+ * _chesscat_perft_brute_force
+ *
+ * Counts leaf nodes as chesscat_perft_brute_force does, generating each ply's moves into the next max_moves moves of move_stack
+ */
+uint64_t _chesscat_perft_brute_force(chesscat_Position *position, uint8_t depth, chesscat_PackedMove move_stack[], uint16_t max_moves)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    uint64_t nodes = 0;
+    uint16_t num_moves = chesscat_generate_moves(position, GenerateAll, move_stack, max_moves);
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        if (!_chesscat_is_packed_move_legal(position, move_stack[i]))
+        {
+            continue;
+        }
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, move_stack[i], &undo);
+        nodes += _chesscat_perft_brute_force(position, depth - 1, move_stack + max_moves, max_moves);
+        chesscat_undo_move(position, &undo);
+    }
+    return nodes;
+}
+
+/*
+ * chesscat_perft_brute_force
+ *
+ * Counts the leaf nodes of the legal move tree to the given depth the slow way: every possible move is played and
+ * tested for leaving a royal piece attacked, with none of the checker and pin shortcuts of chesscat_perft, so the two
+ * can be checked against each other. Returns 0 if the rules allow no moves or memory ran out
+ */
+uint64_t chesscat_perft_brute_force(chesscat_Position *position, uint8_t depth)
+{
+    uint16_t max_moves = chesscat_get_max_moves(&(position->game_rules));
+    if (max_moves == 0)
+    {
+        return 0;
+    }
+    if (depth == 0)
+    {
+        return 1;
+    }
+    chesscat_PackedMove *move_stack = malloc((size_t)depth * max_moves * sizeof(chesscat_PackedMove));
+    if (move_stack == NULL)
+    {
+        return 0;
+    }
+    uint64_t nodes = _chesscat_perft_brute_force(position, depth, move_stack, max_moves);
+    free(move_stack);
+    return nodes;
+}
+
+/*   Evaluation functions   */
+
+/*
+ * chesscat_compute_eval_terms
+ *
+ * Computes each color's material and piece-square sums from scratch into material and piece_squares. Moves keep
+ * the position's sums up to date, so this is only needed to check them
+ */
+void chesscat_compute_eval_terms(chesscat_Position *position, int32_t material[], int32_t piece_squares[])
+{
+    chesscat_Geometry *geometry = _chesscat_position_geometry(position);
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        material[color] = 0;
+        piece_squares[color] = 0;
+        for (uint16_t i = 0; i < position->piece_count[color]; i++)
+        {
+            uint16_t index = position->piece_list[color][i];
+            chesscat_Piece piece = chesscat_get_piece_at_square(position, _chesscat_index_square(index));
+            material[color] += _chesscat_piece_value(piece);
+            if (geometry != NULL)
+            {
+                piece_squares[color] += geometry->piece_squares[color][piece.type][index];
+            }
+        }
+    }
+}
+
+/*
+ * _chesscat_clamp_score
+ *
+ * Keeps a static score short of the mate scores
+ */
+int16_t _chesscat_clamp_score(int32_t score)
+{
+    if (score >= CHESSCAT_MATE_BOUND)
+    {
+        return CHESSCAT_MATE_BOUND - 1;
+    }
+    if (score <= -CHESSCAT_MATE_BOUND)
+    {
+        return -CHESSCAT_MATE_BOUND + 1;
+    }
+    return score;
+}
+
+/*
+ * chesscat_evaluate_material
+ *
+ * Returns a static score of the position in centipawns for the color to play: its material and piece-square sums less
+ * those of the other colors in the game. The sums are kept up to date by every board write, so this takes constant time
+ */
+int16_t chesscat_evaluate_material(chesscat_Position *position)
+{
+    int32_t score = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        if (!position->color_data[color].is_in_game)
+        {
+            continue;
+        }
+        int32_t terms = position->material[color] + position->piece_squares[color];
+        score += color == position->to_move ? terms : -terms;
+    }
+    return _chesscat_clamp_score(score);
+}
+
+/*   Network evaluation functions   */
+
+size_t _chesscat_network_file_size(void)
+{
+    return CHESSCAT_NNUE_HEADER_SIZE +
+           (size_t)CHESSCAT_NNUE_NUM_FEATURES * CHESSCAT_NNUE_L1 * sizeof(int16_t) + CHESSCAT_NNUE_L1 * sizeof(int16_t) +
+           CHESSCAT_NNUE_L2 * CHESSCAT_NNUE_L1 * sizeof(int8_t) + CHESSCAT_NNUE_L2 * sizeof(int32_t) +
+           CHESSCAT_NNUE_L3 * CHESSCAT_NNUE_L2 * sizeof(int8_t) + CHESSCAT_NNUE_L3 * sizeof(int32_t) +
+           CHESSCAT_NNUE_L3 * sizeof(int8_t) + sizeof(int32_t);
+}
+
+/*
+ * _chesscat_network_layout
+ *
+ * Points the loaded network's layers into a weights file's memory. Every layer's size is a multiple of 32 bytes,
+ * so each one starts as aligned as the file
+ */
+void _chesscat_network_layout(uint8_t *memory)
+{
+    uint8_t *layer = memory + CHESSCAT_NNUE_HEADER_SIZE;
+    _chesscat_network.feature_weights = (const int16_t *)layer;
+    layer += (size_t)CHESSCAT_NNUE_NUM_FEATURES * CHESSCAT_NNUE_L1 * sizeof(int16_t);
+    _chesscat_network.feature_biases = (const int16_t *)layer;
+    layer += CHESSCAT_NNUE_L1 * sizeof(int16_t);
+    _chesscat_network.hidden1_weights = (const int8_t *)layer;
+    layer += CHESSCAT_NNUE_L2 * CHESSCAT_NNUE_L1 * sizeof(int8_t);
+    _chesscat_network.hidden1_biases = (const int32_t *)layer;
+    layer += CHESSCAT_NNUE_L2 * sizeof(int32_t);
+    _chesscat_network.hidden2_weights = (const int8_t *)layer;
+    layer += CHESSCAT_NNUE_L3 * CHESSCAT_NNUE_L2 * sizeof(int8_t);
+    _chesscat_network.hidden2_biases = (const int32_t *)layer;
+    layer += CHESSCAT_NNUE_L3 * sizeof(int32_t);
+    _chesscat_network.output_weights = (const int8_t *)layer;
+    layer += CHESSCAT_NNUE_L3 * sizeof(int8_t);
+    _chesscat_network.output_bias = (const int32_t *)layer;
+}
+
+void chesscat_unload_network(void)
+{
+    if (_chesscat_network.memory == NULL)
+    {
+        return;
+    }
+#ifdef CHESSCAT_HAS_MMAP
+    if (_chesscat_network.is_mapped)
+    {
+        munmap(_chesscat_network.memory, _chesscat_network.size);
+    }
+    else
+    {
+        free(_chesscat_network.memory);
+    }
+#else
+    free(_chesscat_network.memory);
+#endif
+    memset(&_chesscat_network, 0, sizeof(_chesscat_network));
+}
+
+/*
+ * chesscat_set_network_simd
+ *
+ * Chooses between the AVX2 and the portable network kernels. Both give the same scores. Returns whether AVX2 is used,
+ * which needs both use_simd and a CPU that supports it. Not thread-safe: no search may run meanwhile
+ */
+bool chesscat_set_network_simd(bool use_simd)
+{
+#ifdef CHESSCAT_HAS_AVX2
+    _chesscat_use_avx2 = use_simd && __builtin_cpu_supports("avx2");
+#else
+    (void)use_simd;
+#endif
+    return _chesscat_use_avx2;
+}
+
+/*
+ * chesscat_load_network
+ *
+ * Loads a weights file for chesscat_evaluate_network, replacing any network loaded before. The file is a
+ * CHESSCAT_NNUE_HEADER_SIZE byte header starting with a chesscat_NetworkHeader, then the layers in the order of
+ * _chesscat_Network. It is mapped read-only where mmap is available, and read into memory otherwise.
+ * Returns false if the file cannot be read or does not match the CHESSCAT_NNUE_ layer sizes.
+ * Not thread-safe: no search may run meanwhile
+ */
+bool chesscat_load_network(const char *path)
+{
+    chesscat_unload_network();
+    size_t size = _chesscat_network_file_size();
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    chesscat_NetworkHeader header;
+    bool is_valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                    header.magic == CHESSCAT_NNUE_MAGIC && header.version == CHESSCAT_NNUE_VERSION &&
+                    header.num_features == CHESSCAT_NNUE_NUM_FEATURES && header.l1 == CHESSCAT_NNUE_L1 &&
+                    header.l2 == CHESSCAT_NNUE_L2 && header.l3 == CHESSCAT_NNUE_L3 &&
+                    fseek(file, 0, SEEK_END) == 0 && ftell(file) == (long)size;
+    if (!is_valid)
+    {
+        fclose(file);
+        return false;
+    }
+    void *memory = NULL;
+    bool is_mapped = false;
+#ifdef CHESSCAT_HAS_MMAP
+    memory = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = NULL;
+    }
+    else
+    {
+        is_mapped = true;
+    }
+#endif
+    if (memory == NULL)
+    {
+        memory = aligned_alloc(64, size);
+        if (memory == NULL || fseek(file, 0, SEEK_SET) != 0 || fread(memory, size, 1, file) != 1)
+        {
+            free(memory);
+            fclose(file);
+            return false;
         }
     }
-    if (moves_like_knight)
+    fclose(file);
+
+    _chesscat_network_layout(memory);
+    _chesscat_network.memory = memory;
+    _chesscat_network.size = size;
+    _chesscat_network.is_mapped = is_mapped;
+    _chesscat_last_network_id++;
+    if (_chesscat_last_network_id == 0)
+    {
+        _chesscat_last_network_id++;
+    }
+    _chesscat_network.id = _chesscat_last_network_id;
+    chesscat_set_network_simd(true);
+    return true;
+}
+
+bool chesscat_has_network(void)
+{
+    return _chesscat_network.id != 0;
+}
+
+#ifdef CHESSCAT_HAS_AVX2
+__attribute__((target("avx2")))
+void _chesscat_network_clip_avx2(const int16_t accumulator[], uint8_t output[])
+{
+    __m256i zero = _mm256_setzero_si256();
+    for (uint16_t i = 0; i < CHESSCAT_NNUE_L1; i += 32)
+    {
+        __m256i low = _mm256_loadu_si256((const __m256i *)(accumulator + i));
+        __m256i high = _mm256_loadu_si256((const __m256i *)(accumulator + i + 16));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high), zero); //Saturates at CHESSCAT_NNUE_ACTIVATION_MAX
+        _mm256_storeu_si256((__m256i *)(output + i), _mm256_permute4x64_epi64(packed, 0xD8)); //Undo the per-lane interleaving of packs
+    }
+}
+
+__attribute__((target("avx2")))
+int32_t _chesscat_network_dot_avx2(const uint8_t input[], const int8_t weights[], uint16_t size)
+{
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (uint16_t i = 0; i < size; i += 32)
+    { // Pairs of products fit in int16_t since inputs are at most CHESSCAT_NNUE_ACTIVATION_MAX
+        __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(input + i)), _mm256_loadu_si256((const __m256i *)(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+/*
+ * _chesscat_network_clip
+ *
+ * Clamps an accumulator to the activation range as the first dense layer's input
+ */
+void _chesscat_network_clip(const int16_t accumulator[], uint8_t output[])
+{
+#ifdef CHESSCAT_HAS_AVX2
+    if (_chesscat_use_avx2)
+    {
+        _chesscat_network_clip_avx2(accumulator, output);
+        return;
+    }
+#endif
+    for (uint16_t i = 0; i < CHESSCAT_NNUE_L1; i++)
+    {
+        int16_t value = accumulator[i];
+        output[i] = value < 0 ? 0 : (value > CHESSCAT_NNUE_ACTIVATION_MAX ? CHESSCAT_NNUE_ACTIVATION_MAX : value);
+    }
+}
+
+/*
+ * _chesscat_network_dot
+ *
+ * Returns the dot product of activations and int8_t weights. size must be a multiple of 32
+ */
+int32_t _chesscat_network_dot(const uint8_t input[], const int8_t weights[], uint16_t size)
+{
+#ifdef CHESSCAT_HAS_AVX2
+    if (_chesscat_use_avx2)
+    {
+        return _chesscat_network_dot_avx2(input, weights, size);
+    }
+#endif
+    int32_t sum = 0;
+    for (uint16_t i = 0; i < size; i++)
+    {
+        sum += input[i] * weights[i];
+    }
+    return sum;
+}
+
+void _chesscat_network_layer(const uint8_t input[], uint16_t input_size, const int8_t weights[], const int32_t biases[], uint8_t output[], uint16_t output_size)
+{
+    for (uint16_t i = 0; i < output_size; i++)
+    {
+        int32_t value = (biases[i] + _chesscat_network_dot(input, weights + i * input_size, input_size)) >> CHESSCAT_NNUE_WEIGHT_SHIFT;
+        output[i] = value < 0 ? 0 : (value > CHESSCAT_NNUE_ACTIVATION_MAX ? CHESSCAT_NNUE_ACTIVATION_MAX : value);
+    }
+}
+
+/*
+ * chesscat_evaluate_network
+ *
+ * Returns the loaded network's score of the position in centipawns for the color to play, from that color's
+ * accumulator. Rebuilds the accumulators first if they are out of date. Falls back to chesscat_evaluate_material if
+ * no network is loaded
+ */
+int16_t chesscat_evaluate_network(chesscat_Position *position)
+{
+    if ((position->network_id == 0 || position->network_id != _chesscat_network.id) && !chesscat_refresh_accumulators(position))
+    {
+        return chesscat_evaluate_material(position);
+    }
+    uint8_t input[CHESSCAT_NNUE_L1];
+    uint8_t hidden1[CHESSCAT_NNUE_L2];
+    uint8_t hidden2[CHESSCAT_NNUE_L3];
+    _chesscat_network_clip(position->accumulators[position->to_move], input);
+    _chesscat_network_layer(input, CHESSCAT_NNUE_L1, _chesscat_network.hidden1_weights, _chesscat_network.hidden1_biases, hidden1, CHESSCAT_NNUE_L2);
+    _chesscat_network_layer(hidden1, CHESSCAT_NNUE_L2, _chesscat_network.hidden2_weights, _chesscat_network.hidden2_biases, hidden2, CHESSCAT_NNUE_L3);
+    int32_t output = *(_chesscat_network.output_bias) + _chesscat_network_dot(hidden2, _chesscat_network.output_weights, CHESSCAT_NNUE_L3);
+    return _chesscat_clamp_score(output / CHESSCAT_NNUE_OUTPUT_SCALE);
+}
+
+/*
+ * chesscat_evaluate
+ *
+ * Returns a static score of the position in centipawns for the color to play, from the network if one is loaded and
+ * from chesscat_evaluate_material otherwise
+ */
+int16_t chesscat_evaluate(chesscat_Position *position)
+{
+    if (_chesscat_network.id != 0)
     {
-        // ordered as 2-square _ 1-square
-        chesscat_Square up_left = {.col = square.col - 1, .row = square.row + 2};
-        chesscat_Square up_right = {.col = square.col + 1, .row = square.row + 2};
+        return chesscat_evaluate_network(position);
+    }
+    return chesscat_evaluate_material(position);
+}
 
-        chesscat_Square right_up = {.col = square.col + 2, .row = square.row + 1};
-        chesscat_Square right_down = {.col = square.col + 2, .row = square.row - 1};
+/*   Pawn structure functions   */
 
-        chesscat_Square down_right = {.col = square.col + 1, .row = square.row - 2};
-        chesscat_Square down_left = {.col = square.col - 1, .row = square.row - 2};
+/*
+ * _chesscat_pawn_table_key
+ *
+ * Returns the key a position's pawn structure is cached under: its pawn hash, with the board size mixed in since the
+ * same pawns score differently on another board
+ */
+uint64_t _chesscat_pawn_table_key(chesscat_Position *position)
+{
+    _chesscat_init_zobrist_keys();
+    return position->pawn_hash ^ _chesscat_zobrist_keys.board_width[position->game_rules.board_width] ^ _chesscat_zobrist_keys.board_height[position->game_rules.board_height];
+}
 
-        chesscat_Square left_down = {.col = square.col - 2, .row = square.row - 1};
-        chesscat_Square left_up = {.col = square.col - 2, .row = square.row + 1};
+/*
+ * chesscat_compute_pawn_entry
+ *
+ * Scores every color's pawn structure from scratch into entry: doubled and isolated pawns are penalised, and passed
+ * pawns, which no pawn of another color can block or capture on their way forward, earn a bonus that grows as they advance.
+ * Files and ranks are taken along each color's direction of play, so Green and Red files are rows
+ */
+void chesscat_compute_pawn_entry(chesscat_Position *position, chesscat_PawnEntry *entry)
+{
+    int16_t rows[CHESSCAT_NUM_SQUARES]; //Every color's pawns
+    int16_t cols[CHESSCAT_NUM_SQUARES];
+    uint8_t pawn_colors[CHESSCAT_NUM_SQUARES];
+    uint16_t pawn_indices[CHESSCAT_NUM_SQUARES];
+    uint16_t num_pawns = 0;
+    uint16_t color_counts[CHESSCAT_NUM_COLORS] = {0};
+    chesscat_Bitboard pawns = position->type_occupancy[Pawn];
+    for (uint16_t index = _chesscat_bitboard_pop_first(&pawns); index < CHESSCAT_NUM_SQUARES; index = _chesscat_bitboard_pop_first(&pawns))
+    {
+        rows[num_pawns] = index / CHESSCAT_MAX_BOARD_SIZE;
+        cols[num_pawns] = index % CHESSCAT_MAX_BOARD_SIZE;
+        pawn_colors[num_pawns] = position->board[rows[num_pawns]][cols[num_pawns]].color;
+        pawn_indices[num_pawns] = index;
+        color_counts[pawn_colors[num_pawns++]]++;
+    }
 
-        if (chesscat_square_in_bounds(position, up_left))
-        {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, up_left);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
-            {
-                chesscat_Move move = {.from = square, .to = up_left};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-            }
-        }
-        if (chesscat_square_in_bounds(position, up_right))
-        {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, up_right);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
-            {
-                chesscat_Move move = {.from = square, .to = up_right};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-            }
-        }
-        if (chesscat_square_in_bounds(position, right_up))
+    entry->key = _chesscat_pawn_table_key(position);
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        entry->scores[color] = 0;
+        _chesscat_bitboard_clear_all(&(entry->passed[color]));
+        if (color_counts[color] == 0)
         {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, right_up);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
-            {
-                chesscat_Move move = {.from = square, .to = right_up};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-            }
+            continue;
         }
-        if (chesscat_square_in_bounds(position, right_down))
+        bool along_rows = color == Green || color == Red; //Whether this color's files are rows
+        bool from_far_edge = color == Black || color == Red; //Whether this color's ranks count down
+        int16_t last_rank = (along_rows ? position->game_rules.board_width : position->game_rules.board_height) - 1;
+        int16_t files[CHESSCAT_NUM_SQUARES]; //Every pawn's file and rank as seen by this color
+        int16_t ranks[CHESSCAT_NUM_SQUARES];
+        uint8_t own_counts[CHESSCAT_MAX_BOARD_SIZE + 2] = {0}; //By file, offset by one so that edge files have neighbours
+        int16_t enemy_ranks[CHESSCAT_MAX_BOARD_SIZE + 2]; //Furthest rank of another color's pawn on each file
+        for (uint8_t file = 0; file < CHESSCAT_MAX_BOARD_SIZE + 2; file++)
         {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, right_down);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
-            {
-                chesscat_Move move = {.from = square, .to = right_down};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
-            }
+            enemy_ranks[file] = -1;
         }
-        if (chesscat_square_in_bounds(position, down_right))
+        for (uint16_t i = 0; i < num_pawns; i++)
         {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, down_right);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
+            files[i] = (along_rows ? rows[i] : cols[i]) + 1;
+            ranks[i] = along_rows ? cols[i] : rows[i];
+            if (from_far_edge)
             {
-                chesscat_Move move = {.from = square, .to = down_right};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
+                ranks[i] = last_rank - ranks[i];
             }
-        }
-        if (chesscat_square_in_bounds(position, down_left))
-        {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, down_left);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
+            if (pawn_colors[i] == color)
             {
-                chesscat_Move move = {.from = square, .to = down_left};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
+                own_counts[files[i]]++;
             }
-        }
-        if (chesscat_square_in_bounds(position, left_down))
-        {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, left_down);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
+            else if (ranks[i] > enemy_ranks[files[i]])
             {
-                chesscat_Move move = {.from = square, .to = left_down};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
+                enemy_ranks[files[i]] = ranks[i];
             }
         }
-        if (chesscat_square_in_bounds(position, left_up))
+        for (uint16_t i = 0; i < num_pawns; i++)
         {
-            chesscat_Piece p = chesscat_get_piece_at_square(position, left_up);
-            if (_chesscat_color_can_capture_piece(position, piece.color, p))
+            if (pawn_colors[i] != color)
             {
-                chesscat_Move move = {.from = square, .to = left_up};
-                _chesscat_add_move_to_buf(move, &moves_buf, &num_moves);
+                continue;
             }
-        }
-    }
-    if (moves_like_bishop)
-    {
-        chesscat_Square toSquare = square;
-        while (true)
-        { // Up-Right
-            toSquare.row++;
-            toSquare.col++;
-            if (!chesscat_square_in_bounds(position, toSquare))
+            int16_t file = files[i];
+            if (own_counts[file] > 1)
             {
-                break;
+                entry->scores[color] -= CHESSCAT_DOUBLED_PAWN_PENALTY;
             }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
+            if (own_counts[file - 1] == 0 && own_counts[file + 1] == 0)
             {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
+                entry->scores[color] -= CHESSCAT_ISOLATED_PAWN_PENALTY;
             }
-            if (moves_buf != NULL)
+            if (enemy_ranks[file - 1] <= ranks[i] && enemy_ranks[file] <= ranks[i] && enemy_ranks[file + 1] <= ranks[i])
             {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
+                _chesscat_bitboard_set(&(entry->passed[color]), pawn_indices[i]);
+                entry->scores[color] += CHESSCAT_PASSED_PAWN_BONUS + (last_rank > 0 ? CHESSCAT_PASSED_PAWN_ADVANCE_BONUS * ranks[i] / last_rank : 0);
             }
-            num_moves++;
         }
+    }
+}
 
-        toSquare = square;
-        while (true)
-        { // Up-Left
-            toSquare.row++;
-            toSquare.col--;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
-            {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
+/*
+ * chesscat_pawn_table_init
+ *
+ * Allocates an empty pawn table. Returns false if the memory cannot be allocated. Free the table with chesscat_pawn_table_free
+ */
+bool chesscat_pawn_table_init(chesscat_PawnTable *table)
+{
+    table->entries = calloc(CHESSCAT_PAWN_TABLE_SIZE, sizeof(chesscat_PawnEntry));
+    table->probes = 0;
+    table->hits = 0;
+    return table->entries != NULL;
+}
+
+void chesscat_pawn_table_free(chesscat_PawnTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+}
+
+/*
+ * chesscat_probe_pawn_table
+ *
+ * Returns the entry for a position's pawn structure, scoring it first unless it is already in the table. The entry
+ * stays valid until the table is probed with another pawn structure
+ */
+chesscat_PawnEntry *chesscat_probe_pawn_table(chesscat_Position *position, chesscat_PawnTable *table)
+{
+    uint64_t key = _chesscat_pawn_table_key(position);
+    chesscat_PawnEntry *entry = &(table->entries[key & (CHESSCAT_PAWN_TABLE_SIZE - 1)]);
+    table->probes++;
+    if (entry->key == key)
+    {
+        table->hits++;
+        return entry;
+    }
+    chesscat_compute_pawn_entry(position, entry);
+    return entry;
+}
+
+/*
+ * chesscat_evaluate_pawns
+ *
+ * Returns the pawn-structure score of the position in centipawns for the color to play: its own score less those of the
+ * other colors in the game. table may be NULL to score the pawns without caching
+ */
+int16_t chesscat_evaluate_pawns(chesscat_Position *position, chesscat_PawnTable *table)
+{
+    chesscat_PawnEntry computed;
+    chesscat_PawnEntry *entry = &computed;
+    if (table != NULL)
+    {
+        entry = chesscat_probe_pawn_table(position, table);
+    }
+    else
+    {
+        chesscat_compute_pawn_entry(position, entry);
+    }
+    int16_t score = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        if (position->color_data[color].is_in_game)
+        {
+            score += color == position->to_move ? entry->scores[color] : -entry->scores[color];
         }
+    }
+    return score;
+}
 
-        toSquare = square;
-        while (true)
-        { // Down-Right
-            toSquare.row--;
-            toSquare.col++;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
-            {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
+/*   Search functions   */
+
+/*
+ * _chesscat_search_time
+ *
+ * Returns a monotonic time in seconds, for measuring how long a search has run
+ */
+double _chesscat_search_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * _chesscat_search_should_stop
+ *
+ * Returns whether the search has been stopped. Every CHESSCAT_SEARCH_CHECK_NODES nodes, a thread adds its nodes to the
+ * shared count and looks at the shared stop flag, and the main thread checks the node and time budgets.
+ * The main thread's first iteration always completes, so that there is a move to play
+ */
+bool _chesscat_search_should_stop(chesscat_Search *search)
+{
+    if (search->stopped)
+    {
+        return true;
+    }
+    if ((search->nodes & (CHESSCAT_SEARCH_CHECK_NODES - 1)) != 0)
+    {
+        return false;
+    }
+    _chesscat_SearchShared *shared = search->shared;
+    uint64_t nodes = __atomic_add_fetch(&(shared->nodes), CHESSCAT_SEARCH_CHECK_NODES, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&(shared->stop), __ATOMIC_RELAXED))
+    {
+        search->stopped = true;
+        return true;
+    }
+    if (search->thread_index != 0 || search->result.depth == 0)
+    {
+        return false;
+    }
+    if ((search->limits.nodes != 0 && nodes >= search->limits.nodes) ||
+        (search->limits.time_ms != 0 && (_chesscat_search_time() - shared->start_time) * 1000 >= search->limits.time_ms))
+    {
+        search->stopped = true;
+        __atomic_store_n(&(shared->stop), true, __ATOMIC_RELAXED);
+    }
+    return search->stopped;
+}
+
+/*
+ * _chesscat_has_lost
+ *
+ * Returns whether the color to play has already lost under rules that do not enforce checks: its royal
+ * pieces, or with capture_all all of its pieces, have been captured
+ */
+bool _chesscat_has_lost(chesscat_Position *position)
+{
+    if (!_chesscat_position_ignores_checks(position))
+    {
+        return false;
+    }
+    if (position->game_rules.capture_all)
+    {
+        return _chesscat_count_pieces(position, position->to_move) == 0;
+    }
+    return !_chesscat_has_royal(position, position->to_move);
+}
+
+/*
+ * _chesscat_is_repetition
+ *
+ * Returns whether the position at ply already occurred earlier on the path from the root
+ */
+bool _chesscat_is_repetition(chesscat_Search *search, uint8_t ply)
+{
+    for (uint8_t i = 0; i < ply; i++)
+    {
+        if (search->path_hashes[i] == search->path_hashes[ply])
+        {
+            return true;
         }
+    }
+    return false;
+}
 
-        toSquare = square;
-        while (true)
-        { // Down-Left
-            toSquare.row--;
-            toSquare.col--;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
-            {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
+/*
+ * _chesscat_score_to_tt
+ *
+ * Converts a mate score from distance to the root to distance to the current ply, so it can be stored and reused at any ply
+ */
+int16_t _chesscat_score_to_tt(int16_t score, uint8_t ply)
+{
+    if (score >= CHESSCAT_MATE_BOUND)
+    {
+        return score + ply;
+    }
+    if (score <= -CHESSCAT_MATE_BOUND)
+    {
+        return score - ply;
+    }
+    return score;
+}
+
+/*
+ * _chesscat_score_from_tt
+ *
+ * Undoes _chesscat_score_to_tt for a score read back at ply
+ */
+int16_t _chesscat_score_from_tt(int16_t score, uint8_t ply)
+{
+    if (score >= CHESSCAT_MATE_BOUND)
+    {
+        return score - ply;
+    }
+    if (score <= -CHESSCAT_MATE_BOUND)
+    {
+        return score + ply;
+    }
+    return score;
+}
+
+/*
+ * _chesscat_update_pv
+ *
+ * Makes move followed by the best line from the next ply the best line from ply
+ */
+void _chesscat_update_pv(chesscat_Search *search, uint8_t ply, chesscat_PackedMove move)
+{
+    search->pv[ply][ply] = move;
+    for (uint8_t i = ply + 1; i < search->pv_length[ply + 1]; i++)
+    {
+        search->pv[ply][i] = search->pv[ply + 1][i];
+    }
+    search->pv_length[ply] = search->pv_length[ply + 1] > ply + 1 ? search->pv_length[ply + 1] : ply + 1;
+}
+
+/*
+ * _chesscat_store_killer
+ *
+ * Remembers a quiet move that caused a cutoff at ply, pushing out the oldest killer
+ */
+void _chesscat_store_killer(chesscat_Search *search, uint8_t ply, chesscat_PackedMove move)
+{
+    chesscat_PackedMove *killers = search->killers[ply];
+    if (killers[0] == move)
+    {
+        return;
+    }
+    for (uint8_t i = CHESSCAT_NUM_KILLERS - 1; i > 0; i--)
+    {
+        killers[i] = killers[i - 1];
+    }
+    killers[0] = move;
+}
+
+/*
+ * _chesscat_init_search_picker
+ *
+ * Sets up a move picker for the node at ply with the search's killers, history and counter move
+ */
+void _chesscat_init_search_picker(chesscat_Search *search, chesscat_MovePicker *picker, uint8_t ply, chesscat_PackedMove hash_move)
+{
+    chesscat_init_move_picker(picker, &(search->position), search->move_stack + (size_t)ply * search->max_moves, search->max_moves, hash_move, search->killers[ply]);
+    chesscat_set_picker_ordering(picker, &(search->ordering), ply > 0 ? search->played[ply - 1] : CHESSCAT_NO_MOVE);
+}
+
+/*
+ * _chesscat_search_cutoff
+ *
+ * Learns from a cutoff by move, the move_number-th move searched at ply: a quiet move becomes a killer, and the
+ * history and counter moves are updated from it and the quiet moves tried before it
+ */
+void _chesscat_search_cutoff(chesscat_Search *search, uint8_t ply, uint8_t depth, chesscat_PackedMove move, chesscat_PackedMove quiets_tried[], uint16_t num_quiets_tried, uint16_t move_number)
+{
+    if (_chesscat_is_quiet_move(move))
+    {
+        _chesscat_store_killer(search, ply, move);
+    }
+    chesscat_record_cutoff(&(search->ordering), move, ply > 0 ? search->played[ply - 1] : CHESSCAT_NO_MOVE, quiets_tried, num_quiets_tried, depth, move_number);
+}
+
+/*
+ * _chesscat_note_quiet
+ *
+ * Adds a move that failed to cause a cutoff to a node's quiet moves tried, if it is quiet and there is room
+ */
+void _chesscat_note_quiet(chesscat_PackedMove quiets_tried[], uint16_t *num_quiets_tried, chesscat_PackedMove move)
+{
+    if (_chesscat_is_quiet_move(move) && *num_quiets_tried < CHESSCAT_MAX_QUIETS_TRIED)
+    {
+        quiets_tried[(*num_quiets_tried)++] = move;
+    }
+}
+
+/*
+ * _chesscat_static_eval
+ *
+ * Returns the search's static evaluation of its position: chesscat_evaluate, plus the pawn structure from the thread's
+ * pawn table unless a network is scoring the position. Scores are cached by position hash, since transpositions and
+ * re-searches evaluate the same positions again
+ */
+int16_t _chesscat_static_eval(chesscat_Search *search)
+{
+    chesscat_Position *position = &(search->position);
+    _chesscat_EvalCacheEntry *entry = &(search->eval_cache[position->hash & (CHESSCAT_EVAL_CACHE_SIZE - 1)]);
+    search->eval_probes++;
+    if (entry->is_valid && entry->key == position->hash)
+    {
+        search->eval_hits++;
+        return entry->score;
+    }
+    int16_t score = chesscat_evaluate(position);
+    if (!chesscat_has_network())
+    {
+        score = _chesscat_clamp_score(score + chesscat_evaluate_pawns(position, &(search->pawn_table)));
+    }
+    entry->key = position->hash;
+    entry->score = score;
+    entry->is_valid = true;
+    return score;
+}
+
+/*
+ * _chesscat_quiesce
+ *
+ * Searches only captures and promotions until the position is quiet, so that the static evaluation is not taken in the
+ * middle of an exchange. The color to play may stand pat on the evaluation, unless it is in check, when every move is searched
+ */
+int16_t _chesscat_quiesce(chesscat_Search *search, int16_t alpha, int16_t beta, uint8_t ply)
+{
+    chesscat_Position *position = &(search->position);
+    search->nodes++;
+    search->pv_length[ply] = ply;
+    if (_chesscat_search_should_stop(search))
+    {
+        return 0;
+    }
+    if (_chesscat_has_lost(position))
+    {
+        return -CHESSCAT_MATE_SCORE + ply;
+    }
+    if (ply >= CHESSCAT_MAX_PLY - 1)
+    {
+        return _chesscat_static_eval(search);
+    }
+
+    bool in_check = chesscat_is_position_check(position);
+    int16_t best_score = -CHESSCAT_INFINITE_SCORE;
+    if (!in_check)
+    {
+        best_score = _chesscat_static_eval(search);
+        if (best_score >= beta)
+        {
+            return best_score;
+        }
+        if (best_score > alpha)
+        {
+            alpha = best_score;
         }
     }
-    if (moves_like_rook)
+
+    chesscat_MovePicker picker;
+    chesscat_PackedMove *moves = search->move_stack + (size_t)ply * search->max_moves;
+    if (in_check)
+    {
+        chesscat_init_move_picker(&picker, position, moves, search->max_moves, CHESSCAT_NO_MOVE, NULL);
+    }
+    else
     {
-        chesscat_Square toSquare = square;
-        while (true)
-        { // Up
-            toSquare.row++;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
+        chesscat_init_capture_picker(&picker, position, moves, search->max_moves);
+    }
+    chesscat_PackedMove move;
+    while ((move = chesscat_pick_move(&picker)) != CHESSCAT_NO_MOVE)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, move, &undo);
+        int16_t score = -_chesscat_quiesce(search, -beta, -alpha, ply + 1);
+        chesscat_undo_move(position, &undo);
+        if (search->stopped)
+        {
+            return 0;
+        }
+        if (score > best_score)
+        {
+            best_score = score;
+            if (score > alpha)
             {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
+                alpha = score;
+                if (alpha >= beta)
                 {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
+                    break;
                 }
-                break;
             }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
         }
+    }
+    if (best_score == -CHESSCAT_INFINITE_SCORE)
+    { // In check with no way out
+        return -CHESSCAT_MATE_SCORE + ply;
+    }
+    return best_score;
+}
 
-        toSquare = square;
-        while (true)
-        { // Left
-            toSquare.col--;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
-            {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
+/*
+ * _chesscat_search_node
+ *
+ * Negamax alpha-beta search of the position to depth, with principal variation search: the first move gets the full
+ * window, the rest a null window that is only widened again when a move beats alpha. Transposition table bounds cut off
+ * nodes outside the principal variation, and checks are extended by a ply
+ */
+int16_t _chesscat_search_node(chesscat_Search *search, uint8_t depth, int16_t alpha, int16_t beta, uint8_t ply, bool is_pv)
+{
+    if (depth == 0)
+    {
+        return _chesscat_quiesce(search, alpha, beta, ply);
+    }
+    chesscat_Position *position = &(search->position);
+    search->nodes++;
+    search->pv_length[ply] = ply;
+    search->path_hashes[ply] = position->hash;
+    if (_chesscat_search_should_stop(search))
+    {
+        return 0;
+    }
+    if (ply > 0)
+    {
+        if (_chesscat_has_lost(position))
+        {
+            return -CHESSCAT_MATE_SCORE + ply;
+        }
+        if (_chesscat_is_repetition(search, ply))
+        {
+            return 0;
         }
+    }
+    if (ply >= CHESSCAT_MAX_PLY - 1)
+    {
+        return _chesscat_static_eval(search);
+    }
 
-        toSquare = square;
-        while (true)
-        { // Down
-            toSquare.row--;
-            if (!chesscat_square_in_bounds(position, toSquare))
-            {
-                break;
-            }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
-            {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
-                }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
-            }
-            num_moves++;
+    chesscat_PackedMove hash_move = CHESSCAT_NO_MOVE;
+    chesscat_TTEntry entry;
+    if (search->tt != NULL && chesscat_tt_probe(search->tt, position->hash, &entry, &(search->tt_stats)))
+    {
+        hash_move = entry.move;
+        int16_t score = _chesscat_score_from_tt(entry.score, ply);
+        if (!is_pv && entry.depth >= depth &&
+            (entry.bound == BoundExact || (entry.bound == BoundLower && score >= beta) || (entry.bound == BoundUpper && score <= alpha)))
+        {
+            return score;
         }
+    }
+
+    bool in_check = chesscat_is_position_check(position);
+    if (in_check)
+    {
+        depth++;
+    }
 
-        toSquare = square;
-        while (true)
-        { // Right
-            toSquare.col++;
-            if (!chesscat_square_in_bounds(position, toSquare))
+    chesscat_MovePicker picker;
+    _chesscat_init_search_picker(search, &picker, ply, hash_move);
+    chesscat_PackedMove quiets_tried[CHESSCAT_MAX_QUIETS_TRIED];
+    uint16_t num_quiets_tried = 0;
+    int16_t original_alpha = alpha;
+    int16_t best_score = -CHESSCAT_INFINITE_SCORE;
+    chesscat_PackedMove best_move = CHESSCAT_NO_MOVE;
+    uint16_t num_moves = 0;
+    chesscat_PackedMove move;
+    while ((move = chesscat_pick_move(&picker)) != CHESSCAT_NO_MOVE)
+    {
+        chesscat_MoveUndo undo;
+        search->played[ply] = move;
+        chesscat_do_move(position, move, &undo);
+        int16_t score;
+        if (num_moves == 0)
+        {
+            score = -_chesscat_search_node(search, depth - 1, -beta, -alpha, ply + 1, is_pv);
+        }
+        else
+        {
+            score = -_chesscat_search_node(search, depth - 1, -alpha - 1, -alpha, ply + 1, false);
+            if (score > alpha && score < beta)
             {
-                break;
+                score = -_chesscat_search_node(search, depth - 1, -beta, -alpha, ply + 1, true);
             }
-            chesscat_Piece hitPiece = chesscat_get_piece_at_square(position, toSquare);
-            if (hitPiece.type != Empty)
+        }
+        chesscat_undo_move(position, &undo);
+        num_moves++;
+        if (search->stopped)
+        {
+            return 0;
+        }
+        if (score > best_score)
+        {
+            best_score = score;
+            best_move = move;
+            if (score > alpha)
             {
-                if (_chesscat_color_can_capture_piece(position, piece.color, hitPiece))
+                alpha = score;
+                _chesscat_update_pv(search, ply, move);
+                if (alpha >= beta)
                 {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = toSquare;
-                    }
-                    num_moves++;
+                    _chesscat_search_cutoff(search, ply, depth, move, quiets_tried, num_quiets_tried, num_moves - 1);
+                    break;
                 }
-                break;
-            }
-            if (moves_buf != NULL)
-            {
-                moves_buf[num_moves].from = square;
-                moves_buf[num_moves].to = toSquare;
             }
-            num_moves++;
         }
+        _chesscat_note_quiet(quiets_tried, &num_quiets_tried, move);
     }
-    if (moves_like_pawn)
+
+    if (num_moves == 0)
+    { // Checkmate, or stalemate
+        return in_check ? -CHESSCAT_MATE_SCORE + ply : 0;
+    }
+    if (search->tt != NULL)
+    {
+        chesscat_EBound bound = best_score >= beta ? BoundLower : best_score > original_alpha ? BoundExact : BoundUpper;
+        chesscat_tt_store(search->tt, position->hash, best_move, _chesscat_score_to_tt(best_score, ply), depth, bound);
+    }
+    return best_score;
+}
+
+/*
+ * _chesscat_search_root
+ *
+ * Searches the root to depth inside an aspiration window around the last iteration's score, widening the window on
+ * whichever side the score falls outside until the score lands inside it. Returns the score
+ */
+int16_t _chesscat_search_root(chesscat_Search *search, uint8_t depth, int16_t last_score)
+{
+    int16_t delta = CHESSCAT_ASPIRATION_WINDOW;
+    int32_t alpha = -CHESSCAT_INFINITE_SCORE;
+    int32_t beta = CHESSCAT_INFINITE_SCORE;
+    if (depth >= CHESSCAT_ASPIRATION_DEPTH && last_score > -CHESSCAT_MATE_BOUND && last_score < CHESSCAT_MATE_BOUND)
+    {
+        alpha = last_score - delta;
+        beta = last_score + delta;
+    }
+    while (true)
     {
-        int8_t row_dist = 0;
-        int8_t col_dist = 0;
-        switch (piece.color)
+        int16_t score = _chesscat_search_node(search, depth, alpha, beta, 0, true);
+        if (search->stopped)
+        {
+            return score;
+        }
+        if (score <= alpha && alpha > -CHESSCAT_INFINITE_SCORE)
+        {
+            alpha = score - delta > -CHESSCAT_INFINITE_SCORE ? score - delta : -CHESSCAT_INFINITE_SCORE;
+        }
+        else if (score >= beta && beta < CHESSCAT_INFINITE_SCORE)
+        {
+            beta = score + delta < CHESSCAT_INFINITE_SCORE ? score + delta : CHESSCAT_INFINITE_SCORE;
+        }
+        else
+        {
+            return score;
+        }
+        delta *= 2;
+    }
+}
+
+/*
+ * _chesscat_record_iteration
+ *
+ * Makes a completed iteration's score and principal variation the search's result
+ */
+void _chesscat_record_iteration(chesscat_Search *search, uint8_t depth, int16_t score)
+{
+    search->result.score = score;
+    search->result.depth = depth;
+    search->result.pv_length = search->pv_length[0];
+    memcpy(search->result.pv, search->pv[0], search->pv_length[0] * sizeof(chesscat_PackedMove));
+    search->result.best_move = search->pv_length[0] > 0 ? search->pv[0][0] : CHESSCAT_NO_MOVE;
+}
+
+/*
+ * _chesscat_max_depth
+ *
+ * Returns the deepest iteration a search may run under its limits
+ */
+uint8_t _chesscat_max_depth(chesscat_SearchLimits *limits)
+{
+    return limits->depth != 0 && limits->depth < CHESSCAT_MAX_PLY ? limits->depth : CHESSCAT_MAX_PLY - 1;
+}
+
+static const uint8_t _chesscat_skip_size[CHESSCAT_NUM_SKIP_PATTERNS] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const uint8_t _chesscat_skip_phase[CHESSCAT_NUM_SKIP_PATTERNS] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+/*
+ * _chesscat_skip_depth
+ *
+ * Returns whether a helper thread skips an iteration. Each helper skips depths in its own pattern of runs,
+ * so that the threads spread over several depths instead of all searching the same tree
+ */
+bool _chesscat_skip_depth(chesscat_Search *search, uint8_t depth)
+{
+    if (search->thread_index == 0 || depth == 1)
+    {
+        return false;
+    }
+    uint8_t pattern = (search->thread_index - 1) % CHESSCAT_NUM_SKIP_PATTERNS;
+    return ((depth + _chesscat_skip_phase[pattern]) / _chesscat_skip_size[pattern]) % 2 != 0;
+}
+
+/*
+ * _chesscat_iterate
+ *
+ * Runs a two-player search's iterative deepening loop until it reaches its depth limit, finds a mate or is stopped
+ */
+void _chesscat_iterate(chesscat_Search *search)
+{
+    uint8_t max_depth = _chesscat_max_depth(&(search->limits));
+    int16_t score = 0;
+    for (uint8_t depth = 1; depth <= max_depth; depth++)
+    {
+        if (_chesscat_skip_depth(search, depth))
+        {
+            continue;
+        }
+        score = _chesscat_search_root(search, depth, score);
+        if (search->stopped)
         {
-        case White:
-            row_dist = 1;
-            break;
-        case Black:
-            row_dist = -1;
-            break;
-        case Red:
-            col_dist = -1;
             break;
-        case Green:
-            col_dist = 1;
+        }
+        _chesscat_record_iteration(search, depth, score);
+        if (search->result.best_move == CHESSCAT_NO_MOVE ||
+            CHESSCAT_MATE_SCORE - abs(score) <= depth)
+        { // No moves, or a mate found within the full-width horizon
             break;
         }
+    }
+}
 
-        chesscat_Square advance_square = {.row = square.row + row_dist, .col = square.col + col_dist};
+/*   Multi-player search functions   */
 
-        if (chesscat_square_in_bounds(position, advance_square))
-        {
-            chesscat_Square take_left_square = {.row = square.row + row_dist - col_dist, .col = square.col + col_dist - row_dist};
-            chesscat_Square take_right_square = {.row = square.row + row_dist + col_dist, .col = square.col + col_dist + row_dist};
+/*
+ * _chesscat_is_color_alive
+ *
+ * Returns whether a color is still playing: it is in the game and has a royal piece, or with capture_all any piece
+ */
+bool _chesscat_is_color_alive(chesscat_Position *position, chesscat_EColor color)
+{
+    if (!position->color_data[color].is_in_game)
+    {
+        return false;
+    }
+    return position->game_rules.capture_all ? _chesscat_count_pieces(position, color) > 0 : _chesscat_has_royal(position, color);
+}
 
-            chesscat_Piece advance_piece = chesscat_get_piece_at_square(position, advance_square);
+uint8_t _chesscat_count_alive_colors(chesscat_Position *position)
+{
+    uint8_t num_alive = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        num_alive += _chesscat_is_color_alive(position, color);
+    }
+    return num_alive;
+}
 
-            if (advance_piece.type == Empty)
-            {
-                if (moves_buf != NULL)
-                {
-                    moves_buf[num_moves].from = square;
-                    moves_buf[num_moves].to = advance_square;
-                }
-                num_moves++;
-                if (position->game_rules.torpedo_pawns ||
-                    (piece.color == White && square.row <= 1) ||
-                    (piece.color == Black && square.row >= position->game_rules.board_height - 2) ||
-                    (piece.color == Green && square.col >= 1) ||
-                    (piece.color == Red && square.col >= position->game_rules.board_width - 2))
-                {
-                    chesscat_Square double_advance_square = {.row = square.row + row_dist * 2, .col = square.col + col_dist * 2};
-                    if (chesscat_square_in_bounds(position, double_advance_square))
-                    {
-                        chesscat_Piece double_advance_piece = chesscat_get_piece_at_square(position, double_advance_square);
-                        if (double_advance_piece.type == Empty)
-                        {
-                            if (moves_buf != NULL)
-                            {
-                                moves_buf[num_moves].from = square;
-                                moves_buf[num_moves].to = double_advance_square;
-                            }
-                            num_moves++;
-                        }
-                    }
-                }
-            }
-            else if(position->game_rules.kangaroo_pawns){
-                chesscat_Square double_advance_square = {.row = square.row + row_dist * 2, .col = square.col + col_dist * 2};
-                if (chesscat_square_in_bounds(position, double_advance_square))
-                {
-                    chesscat_Piece double_advance_piece = chesscat_get_piece_at_square(position, double_advance_square);
-                    if (double_advance_piece.type == Empty)
-                    {
-                        if (moves_buf != NULL)
-                        {
-                            moves_buf[num_moves].from = square;
-                            moves_buf[num_moves].to = double_advance_square;
-                        }
-                        num_moves++;
-                    }
-                }
-            }
-            if (chesscat_square_in_bounds(position, take_left_square))
-            {
-                chesscat_Piece take_left_piece = chesscat_get_piece_at_square(position, take_left_square);
-                if (take_left_piece.type != Empty && _chesscat_color_can_capture_piece(position, piece.color, take_left_piece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = take_left_square;
-                    }
-                    num_moves++;
-                }
-                if (_chesscat_same_squares(take_left_square, position->passantable_square) && take_left_piece.type == Empty)
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = take_left_square;
-                    }
-                    num_moves++;
-                }
-            }
-            if (chesscat_square_in_bounds(position, take_right_square))
-            {
-                chesscat_Piece take_right_piece = chesscat_get_piece_at_square(position, take_right_square);
-                if (take_right_piece.type != Empty && _chesscat_color_can_capture_piece(position, piece.color, take_right_piece))
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = take_right_square;
-                    }
-                    num_moves++;
-                }
-                if (_chesscat_same_squares(take_right_square, position->passantable_square) && take_right_piece.type == Empty)
-                {
-                    if (moves_buf != NULL)
-                    {
-                        moves_buf[num_moves].from = square;
-                        moves_buf[num_moves].to = take_right_square;
-                    }
-                    num_moves++;
-                }
-            }
+/*
+ * _chesscat_share_scores
+ *
+ * Writes each color's share of CHESSCAT_MULTI_TOTAL_SCORE to scores, split by material between the colors still playing,
+ * adjusted by their pawn structure if pawns is not NULL. lost_color is counted as out of the game even if it still has its pieces, as when it has been checkmated, and may be
+ * CHESSCAT_NUM_COLORS for none. The scores never add up to more than the total
+ */
+void _chesscat_share_scores(chesscat_Position *position, chesscat_PawnEntry *pawns, uint8_t lost_color, int16_t scores[])
+{
+    int64_t values[CHESSCAT_NUM_COLORS];
+    int64_t total = 0;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        bool alive = color != lost_color && _chesscat_is_color_alive(position, color);
+        values[color] = alive ? position->material[color] + CHESSCAT_MULTI_ALIVE_VALUE : 0;
+        if (alive && pawns != NULL)
+        {
+            values[color] += pawns->scores[color];
+        }
+        if (values[color] < 0)
+        {
+            values[color] = 0;
         }
+        total += values[color];
+    }
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        scores[color] = total > 0 ? values[color] * CHESSCAT_MULTI_TOTAL_SCORE / total : 0;
+    }
+}
 
-        if(position->game_rules.sideways_pawns){
-            chesscat_Square left_square = {.row = square.row - col_dist, .col = square.col - row_dist};
-            chesscat_Square right_square = {.row = square.row + col_dist, .col = square.col + row_dist};
+/*
+ * chesscat_evaluate_colors
+ *
+ * Writes a static score for every color to scores: its share of CHESSCAT_MULTI_TOTAL_SCORE, split by material between
+ * the colors still playing. Colors out of the game score 0
+ */
+void chesscat_evaluate_colors(chesscat_Position *position, int16_t scores[])
+{
+    _chesscat_share_scores(position, NULL, CHESSCAT_NUM_COLORS, scores);
+}
 
-            if(chesscat_square_in_bounds(position, left_square) && _chesscat_color_can_capture_piece(position, piece.color, chesscat_get_piece_at_square(position, left_square))){
-                if(moves_buf != NULL){
-                    moves_buf[num_moves].from = square;
-                    moves_buf[num_moves].to = left_square;
-                }
-                num_moves++;
-            }
-            if(chesscat_square_in_bounds(position, right_square) && _chesscat_color_can_capture_piece(position, piece.color, chesscat_get_piece_at_square(position, right_square))){
-                if(moves_buf != NULL){
-                    moves_buf[num_moves].from = square;
-                    moves_buf[num_moves].to = right_square;
-                }
-                num_moves++;
-            }
-        }
+/*
+ * _chesscat_evaluate_no_moves
+ *
+ * Scores a position where the color to play has no legal move: checkmate knocks it out, stalemate is scored statically
+ */
+void _chesscat_evaluate_no_moves(chesscat_Search *search, int16_t scores[])
+{
+    chesscat_Position *position = &(search->position);
+    _chesscat_share_scores(position, chesscat_probe_pawn_table(position, &(search->pawn_table)), chesscat_is_position_check(position) ? position->to_move : CHESSCAT_NUM_COLORS, scores);
+}
+
+/*
+ * _chesscat_set_to_move
+ *
+ * Hands the turn to a color out of order, keeping the hash in step. Used by best-reply search to let one opponent
+ * move while the others pass
+ */
+void _chesscat_set_to_move(chesscat_Position *position, chesscat_EColor color)
+{
+    position->hash ^= _chesscat_zobrist_keys.to_move[position->to_move] ^ _chesscat_zobrist_keys.to_move[color];
+    position->to_move = color;
+}
+
+/*
+ * _chesscat_multi_hash_move
+ *
+ * Returns the best move stored for the search's position, or CHESSCAT_NO_MOVE
+ */
+chesscat_PackedMove _chesscat_multi_hash_move(chesscat_Search *search)
+{
+    chesscat_TTEntry entry;
+    if (search->tt != NULL && chesscat_tt_probe(search->tt, search->position.hash, &entry, &(search->tt_stats)))
+    {
+        return entry.move;
+    }
+    return CHESSCAT_NO_MOVE;
+}
+
+/*
+ * _chesscat_multi_store_move
+ *
+ * Stores the best move found for the search's position. Multi-player scores depend on the searching color, so only
+ * the move is kept, at depth 0 so that two-player searches never take a cutoff from it
+ */
+void _chesscat_multi_store_move(chesscat_Search *search, chesscat_PackedMove move)
+{
+    if (search->tt != NULL && move != CHESSCAT_NO_MOVE)
+    {
+        chesscat_tt_store(search->tt, search->position.hash, move, 0, 0, BoundExact);
+    }
+}
 
+/*
+ * _chesscat_multi_leaf
+ *
+ * Counts a multi-player search node and returns whether it is a leaf: the depth is used up, the game is decided
+ * for the searching color, or the search has run out of budget. Leaves are scored statically into scores
+ */
+bool _chesscat_multi_leaf(chesscat_Search *search, uint8_t depth, uint8_t ply, int16_t scores[])
+{
+    chesscat_Position *position = &(search->position);
+    search->nodes++;
+    search->pv_length[ply] = ply;
+    if (depth == 0 || ply >= CHESSCAT_MAX_PLY - 1 || _chesscat_search_should_stop(search) ||
+        !_chesscat_is_color_alive(position, search->root_color) || _chesscat_count_alive_colors(position) <= 1)
+    {
+        _chesscat_share_scores(position, chesscat_probe_pawn_table(position, &(search->pawn_table)), CHESSCAT_NUM_COLORS, scores);
+        return true;
     }
-
-    return num_moves;
+    return false;
 }
 
 /*
- * chesscat_get_all_possible_moves
+ * _chesscat_paranoid
  *
- * Writes all possible (not necessarily legal) moves for the current color to play to moves_buf
+ * Paranoid search: the searching color maximises its score and every other color is assumed to minimise it,
+ * which makes the game two-player and allows full alpha-beta pruning on the searching color's score
  */
-uint16_t chesscat_get_all_possible_moves(chesscat_Position *position, chesscat_Move moves_buf[])
+void _chesscat_paranoid(chesscat_Search *search, uint8_t depth, int16_t alpha, int16_t beta, uint8_t ply, int16_t scores[])
 {
-    uint16_t move_count = 0;
-    for (uint8_t row = 0; row < position->game_rules.board_height; row++)
+    if (_chesscat_multi_leaf(search, depth, ply, scores))
     {
-        for (uint8_t col = 0; col < position->game_rules.board_width; col++)
+        return;
+    }
+    chesscat_Position *position = &(search->position);
+    chesscat_EColor root = search->root_color;
+    bool maximizing = position->to_move == root;
+
+    chesscat_MovePicker picker;
+    _chesscat_init_search_picker(search, &picker, ply, _chesscat_multi_hash_move(search));
+    chesscat_PackedMove quiets_tried[CHESSCAT_MAX_QUIETS_TRIED];
+    uint16_t num_quiets_tried = 0;
+    uint16_t num_moves = 0;
+    int16_t child_scores[CHESSCAT_NUM_COLORS];
+    chesscat_PackedMove best_move = CHESSCAT_NO_MOVE;
+    chesscat_PackedMove move;
+    while ((move = chesscat_pick_move(&picker)) != CHESSCAT_NO_MOVE)
+    {
+        chesscat_MoveUndo undo;
+        search->played[ply] = move;
+        chesscat_do_move(position, move, &undo);
+        _chesscat_paranoid(search, depth - 1, alpha, beta, ply + 1, child_scores);
+        chesscat_undo_move(position, &undo);
+        num_moves++;
+        if (search->stopped)
+        {
+            return;
+        }
+        if (best_move == CHESSCAT_NO_MOVE || (maximizing ? child_scores[root] > scores[root] : child_scores[root] < scores[root]))
         {
-            chesscat_Square square = {.row = row, .col = col};
-            chesscat_Move *buf_pos = NULL;
-            if (moves_buf != NULL)
+            memcpy(scores, child_scores, sizeof(child_scores));
+            best_move = move;
+            _chesscat_update_pv(search, ply, move);
+            if (maximizing && scores[root] > alpha)
+            {
+                alpha = scores[root];
+            }
+            else if (!maximizing && scores[root] < beta)
+            {
+                beta = scores[root];
+            }
+            if (alpha >= beta)
             {
-                buf_pos = &(moves_buf[move_count]);
+                _chesscat_search_cutoff(search, ply, depth, move, quiets_tried, num_quiets_tried, num_moves - 1);
+                break;
             }
-            move_count += chesscat_get_possible_moves_from(position, square, buf_pos);
         }
+        _chesscat_note_quiet(quiets_tried, &num_quiets_tried, move);
     }
-    return move_count;
+    if (best_move == CHESSCAT_NO_MOVE)
+    {
+        _chesscat_evaluate_no_moves(search, scores);
+        return;
+    }
+    _chesscat_multi_store_move(search, best_move);
 }
 
-bool _chesscat_can_royal_be_captured(chesscat_Position *position)
-{ // Whether a royal can be captured in the given position
-    chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)];
-    uint16_t num_moves = chesscat_get_all_possible_moves(position, moves); // TODO: Replace this with something more efficient
+/*
+ * _chesscat_maxn
+ *
+ * Max^n search: every color maximises its own score. Since the scores add up to at most CHESSCAT_MULTI_TOTAL_SCORE,
+ * a node can be cut off once its color scores bound, the most it can get without the parent's color preferring
+ * a move it has already searched (shallow pruning)
+ */
+void _chesscat_maxn(chesscat_Search *search, uint8_t depth, int16_t bound, uint8_t ply, int16_t scores[])
+{
+    if (_chesscat_multi_leaf(search, depth, ply, scores))
+    {
+        return;
+    }
+    chesscat_Position *position = &(search->position);
+    chesscat_EColor color = position->to_move;
 
-    for (uint16_t i = 0; i < num_moves; i++)
+    chesscat_MovePicker picker;
+    _chesscat_init_search_picker(search, &picker, ply, _chesscat_multi_hash_move(search));
+    chesscat_PackedMove quiets_tried[CHESSCAT_MAX_QUIETS_TRIED];
+    uint16_t num_quiets_tried = 0;
+    uint16_t num_moves = 0;
+    int16_t child_scores[CHESSCAT_NUM_COLORS];
+    chesscat_PackedMove best_move = CHESSCAT_NO_MOVE;
+    chesscat_PackedMove move;
+    while ((move = chesscat_pick_move(&picker)) != CHESSCAT_NO_MOVE)
     {
-        chesscat_Move move = moves[i];
-        chesscat_Piece piece = chesscat_get_piece_at_square(position, move.to);
-        if (piece.is_royal && piece.color != position->to_move)
+        int16_t child_bound = CHESSCAT_MULTI_TOTAL_SCORE - (best_move == CHESSCAT_NO_MOVE ? 0 : scores[color]);
+        chesscat_MoveUndo undo;
+        search->played[ply] = move;
+        chesscat_do_move(position, move, &undo);
+        _chesscat_maxn(search, depth - 1, child_bound, ply + 1, child_scores);
+        chesscat_undo_move(position, &undo);
+        num_moves++;
+        if (search->stopped)
         {
-            return true;
+            return;
+        }
+        if (best_move == CHESSCAT_NO_MOVE || child_scores[color] > scores[color])
+        {
+            memcpy(scores, child_scores, sizeof(child_scores));
+            best_move = move;
+            _chesscat_update_pv(search, ply, move);
+            if (scores[color] >= bound)
+            {
+                _chesscat_search_cutoff(search, ply, depth, move, quiets_tried, num_quiets_tried, num_moves - 1);
+                break;
+            }
         }
+        _chesscat_note_quiet(quiets_tried, &num_quiets_tried, move);
     }
-    return false;
+    if (best_move == CHESSCAT_NO_MOVE)
+    {
+        _chesscat_evaluate_no_moves(search, scores);
+        return;
+    }
+    _chesscat_multi_store_move(search, best_move);
 }
 
 /*
- * chesscat_move_pieces
+ * _chesscat_best_reply
  *
- * Sets the new positions of pieces according to a move, including captures, castles, and en passants
- * Does not set other positional data such as the color to play or pieces captured
+ * Best-reply search: the searching color's moves alternate with a single layer holding the moves of every other
+ * color, of which only the one most damaging to the searching color is played while the rest pass. This reaches
+ * deeper than paranoid search for the same depth of the searching color's moves, with full alpha-beta pruning
  */
-void chesscat_move_pieces(chesscat_Position *position, chesscat_Move move)
-{ // Sets piece positions only
-    chesscat_Piece empty = {.color = White, .is_royal = false, .type = Empty};
-    chesscat_Piece moving = chesscat_get_piece_at_square(position, move.from);
-
-    if (moving.type == King && moving.is_royal && position->game_rules.allow_castle &&
-        !position->color_data[moving.color].has_king_moved)
-    { // Castling logic
-        if (moving.color == White || moving.color == Black)
+void _chesscat_best_reply(chesscat_Search *search, uint8_t depth, int16_t alpha, int16_t beta, uint8_t ply, int16_t scores[])
+{
+    if (_chesscat_multi_leaf(search, depth, ply, scores))
+    {
+        return;
+    }
+    chesscat_Position *position = &(search->position);
+    chesscat_EColor root = search->root_color;
+    chesscat_EColor to_move = position->to_move;
+    bool maximizing = to_move == root;
+
+    int16_t child_scores[CHESSCAT_NUM_COLORS];
+    chesscat_PackedMove best_move = CHESSCAT_NO_MOVE;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS && alpha < beta; color++)
+    {
+        if (maximizing ? color != root : color == root || !_chesscat_is_color_alive(position, color))
+        {
+            continue;
+        }
+        _chesscat_set_to_move(position, color);
+        chesscat_MovePicker picker;
+        _chesscat_init_search_picker(search, &picker, ply, _chesscat_multi_hash_move(search));
+        chesscat_PackedMove quiets_tried[CHESSCAT_MAX_QUIETS_TRIED];
+        uint16_t num_quiets_tried = 0;
+        uint16_t num_moves = 0;
+        chesscat_PackedMove color_best_move = CHESSCAT_NO_MOVE;
+        int16_t color_best_score = 0;
+        chesscat_PackedMove move;
+        while ((move = chesscat_pick_move(&picker)) != CHESSCAT_NO_MOVE)
         {
-            int8_t move_dist = move.to.col - move.from.col;
-            if (move_dist > 1 && !position->color_data[moving.color].has_upper_rook_moved)
+            chesscat_MoveUndo undo;
+            search->played[ply] = move;
+            chesscat_do_move(position, move, &undo);
+            if (!maximizing)
+            { // Back to the searching color, whoever would have played next
+                _chesscat_set_to_move(position, root);
+            }
+            _chesscat_best_reply(search, depth - 1, alpha, beta, ply + 1, child_scores);
+            chesscat_undo_move(position, &undo);
+            num_moves++;
+            if (search->stopped)
             {
-                chesscat_Square rookSquare = _chesscat_find_upper_rook(position, moving.color);
-                chesscat_Move rookMove;
-                rookMove.from = rookSquare;
-                chesscat_Square rookSquare2 = {.row = rookSquare.row, .col = move.to.col - 1};
-                rookMove.to = rookSquare2;
-                if (chesscat_is_valid_square(rookSquare))
-                {
-                    chesscat_move_pieces(position, rookMove);
-                }
+                _chesscat_set_to_move(position, to_move);
+                return;
             }
-            if (move_dist < -1 && !position->color_data[moving.color].has_lower_rook_moved)
+            if (color_best_move == CHESSCAT_NO_MOVE || (maximizing ? child_scores[root] > color_best_score : child_scores[root] < color_best_score))
             {
-                chesscat_Square rookSquare = _chesscat_find_lower_rook(position, moving.color);
-                chesscat_Move rookMove;
-                rookMove.from = rookSquare;
-                chesscat_Square rookSquare2 = {.row = rookSquare.row, .col = move.to.col + 1};
-                rookMove.to = rookSquare2;
-                if (chesscat_is_valid_square(rookSquare))
-                {
-                    chesscat_move_pieces(position, rookMove);
-                }
+                color_best_move = move;
+                color_best_score = child_scores[root];
             }
-        }
-        else
-        {
-            int8_t move_dist = move.from.row - move.to.row;
-            if (move_dist > 1 && !position->color_data[moving.color].has_upper_rook_moved)
+            if (best_move == CHESSCAT_NO_MOVE || (maximizing ? child_scores[root] > scores[root] : child_scores[root] < scores[root]))
             {
-                chesscat_Square rookSquare = _chesscat_find_upper_rook(position, moving.color);
-                chesscat_Move rookMove;
-                rookMove.from = rookSquare;
-                chesscat_Square rookSquare2 = {.row = move.to.col - 1, .col = rookSquare.col};
-                rookMove.to = rookSquare2;
-                if (chesscat_is_valid_square(rookSquare))
+                memcpy(scores, child_scores, sizeof(child_scores));
+                best_move = move;
+                _chesscat_update_pv(search, ply, move);
+                if (maximizing && scores[root] > alpha)
                 {
-                    chesscat_move_pieces(position, rookMove);
+                    alpha = scores[root];
                 }
-            }
-            if (move_dist < -1 && position->color_data[moving.color].has_lower_rook_moved)
-            {
-                chesscat_Square rookSquare = _chesscat_find_upper_rook(position, moving.color);
-                chesscat_Move rookMove;
-                rookMove.from = rookSquare;
-                chesscat_Square rookSquare2 = {.row = move.to.col + 1, .col = rookSquare.col};
-                rookMove.to = rookSquare2;
-                if (chesscat_is_valid_square(rookSquare))
+                else if (!maximizing && scores[root] < beta)
+                {
+                    beta = scores[root];
+                }
+                if (alpha >= beta)
                 {
-                    chesscat_move_pieces(position, rookMove);
+                    _chesscat_search_cutoff(search, ply, depth, move, quiets_tried, num_quiets_tried, num_moves - 1);
+                    break;
                 }
             }
+            _chesscat_note_quiet(quiets_tried, &num_quiets_tried, move);
         }
+        _chesscat_multi_store_move(search, color_best_move);
     }
-    if (moving.type == Pawn)
+    _chesscat_set_to_move(position, to_move);
+    if (best_move == CHESSCAT_NO_MOVE)
     {
-        if (_chesscat_same_squares(move.to, position->passantable_square) && move.from.col != move.to.col && move.from.row != move.to.row)
-        {
-            chesscat_set_piece_at_square(position, position->passant_target_square, empty);
-        }
+        _chesscat_evaluate_no_moves(search, scores);
     }
-    chesscat_set_piece_at_square(position, move.to, chesscat_get_piece_at_square(position, move.from));
-    chesscat_set_piece_at_square(position, move.from, empty);
 }
 
 /*
- * chesscat_make_move
+ * _chesscat_iterate_multi
  *
- * Plays a move in the given position, setting all positional data as required
+ * Runs a multi-player search's iterative deepening loop until it reaches its depth limit, the game is decided
+ * or it is stopped
  */
-void chesscat_make_move(chesscat_Position *position, chesscat_Move move, chesscat_EPieceType pawn_promotion)
+void _chesscat_iterate_multi(chesscat_Search *search)
 {
-    chesscat_Piece piece = chesscat_get_piece_at_square(position, move.from);
-    chesscat_Square none = {.row = -1, .col = -1};
-    chesscat_move_pieces(position, move);
-    bool pawn_promotes = false;
-    position->passant_target_square = none;
-    position->passantable_square = none;
-    if (piece.type == King)
+    uint8_t max_depth = _chesscat_max_depth(&(search->limits));
+    for (uint8_t depth = 1; depth <= max_depth; depth++)
     {
-        _chesscat_EMoveCasleType castle_type = _chesscat_move_castles(position, move);
-        position->color_data[position->to_move].has_king_moved = true;
-        if (castle_type == UpperCastle)
+        if (_chesscat_skip_depth(search, depth))
         {
-            position->color_data[position->to_move].has_upper_rook_moved = true;
+            continue;
         }
-        else if (castle_type == LowerCastle)
+        int16_t scores[CHESSCAT_NUM_COLORS];
+        switch (search->shared->algorithm)
         {
-            position->color_data[position->to_move].has_lower_rook_moved = true;
+        case Paranoid:
+            _chesscat_paranoid(search, depth, -1, CHESSCAT_MULTI_TOTAL_SCORE + 1, 0, scores);
+            break;
+        case MaxN:
+            _chesscat_maxn(search, depth, CHESSCAT_MULTI_TOTAL_SCORE + 1, 0, scores);
+            break;
+        default:
+            _chesscat_best_reply(search, depth, -1, CHESSCAT_MULTI_TOTAL_SCORE + 1, 0, scores);
+            break;
         }
-    }
-    else if (piece.type == Rook)
-    {
-        chesscat_Square lower_rook = _chesscat_find_lower_rook(position, position->to_move);
-        chesscat_Square upper_rook = _chesscat_find_upper_rook(position, position->to_move);
-        if (_chesscat_same_squares(lower_rook, move.from))
+        if (search->stopped)
         {
-            position->color_data[position->to_move].has_lower_rook_moved = true;
+            break;
         }
-        else if (_chesscat_same_squares(upper_rook, move.from))
+        _chesscat_record_iteration(search, depth, scores[search->root_color]);
+        memcpy(search->result.scores, scores, sizeof(scores));
+        if (search->result.best_move == CHESSCAT_NO_MOVE || _chesscat_count_alive_colors(&(search->position)) <= 1)
         {
-            position->color_data[position->to_move].has_upper_rook_moved = true;
+            break;
         }
     }
-    else if (piece.type == Pawn)
+}
+
+/*   Parallel search functions   */
+
+/*
+ * _chesscat_new_search
+ *
+ * Allocates one thread's search of a copy of position, with its own move stack sized for the position's rules and
+ * its own killer and principal variation tables. Returns NULL if memory ran out
+ */
+chesscat_Search *_chesscat_new_search(chesscat_Position *position, chesscat_TranspositionTable *tt, chesscat_SearchLimits *limits, _chesscat_SearchShared *shared, uint16_t thread_index)
+{
+    uint16_t max_moves = chesscat_get_max_moves(&(position->game_rules));
+    chesscat_Search *search = malloc(sizeof(chesscat_Search));
+    if (search == NULL || max_moves == 0)
     {
-        int8_t col_dist = move.to.col - move.from.col;
-        int8_t row_dist = move.to.row - move.from.row;
-        if (col_dist > 1)
-        {
-            chesscat_Square passant = {.row = move.from.row, .col = move.from.col + 1};
-            position->passantable_square = passant;
-            position->passant_target_square = move.to;
-        }
-        else if (col_dist < -1)
-        {
-            chesscat_Square passant = {.row = move.from.row, .col = move.from.col - 1};
-            position->passantable_square = passant;
-            position->passant_target_square = move.to;
-        }
-        if (row_dist > 1)
-        {
-            chesscat_Square passant = {.row = move.from.row + 1, .col = move.from.col};
-            position->passantable_square = passant;
-            position->passant_target_square = move.to;
-        }
-        else if (row_dist < -1)
-        {
-            chesscat_Square passant = {.row = move.from.row - 1, .col = move.from.col};
-            position->passantable_square = passant;
-            position->passant_target_square = move.to;
-        }
-        if (_chesscat_square_on_promotion_rank(position, move.to, piece.color))
-        {
-            pawn_promotes = true;
-        }
+        free(search);
+        return NULL;
     }
-    // TODO: Do Captured_Pieces here
-    // TODO: Do Num_Checks here
-    if (pawn_promotes)
+    search->move_stack = malloc((size_t)CHESSCAT_MAX_PLY * max_moves * sizeof(chesscat_PackedMove));
+    search->eval_cache = calloc(CHESSCAT_EVAL_CACHE_SIZE, sizeof(_chesscat_EvalCacheEntry));
+    if (!chesscat_pawn_table_init(&(search->pawn_table)) || search->move_stack == NULL || search->eval_cache == NULL)
     {
-        chesscat_Piece promotion = {.color = piece.color, .is_royal = false, .type = pawn_promotion};
-        chesscat_set_piece_at_square(position, move.to, promotion);
+        chesscat_pawn_table_free(&(search->pawn_table));
+        free(search->eval_cache);
+        free(search->move_stack);
+        free(search);
+        return NULL;
     }
-    _chesscat_set_next_to_play(position);
+    search->eval_probes = 0;
+    search->eval_hits = 0;
+    search->position = *position;
+    search->root_color = position->to_move;
+    search->tt = tt;
+    search->limits = *limits;
+    search->shared = shared;
+    search->thread_index = thread_index;
+    search->nodes = 0;
+    search->stopped = false;
+    search->tt_stats.probes = 0;
+    search->tt_stats.hits = 0;
+    search->max_moves = max_moves;
+    memset(search->killers, 0, sizeof(search->killers));
+    chesscat_clear_move_ordering(&(search->ordering));
+    memset(&(search->result), 0, sizeof(search->result));
+    return search;
 }
 
-bool chesscat_is_position_check(chesscat_Position *position){
-    bool isCheck = false;
-    if(!_chesscat_position_ignores_checks(position)){
-        chesscat_Position pos_copy = *position;
-
-        _chesscat_set_next_to_play(&pos_copy);
-
-        if(_chesscat_can_royal_be_captured(&pos_copy)){
-            isCheck = true;
-        }
-    }
-    return isCheck;
+void _chesscat_free_search(chesscat_Search *search)
+{
+    chesscat_pawn_table_free(&(search->pawn_table));
+    free(search->eval_cache);
+    free(search->move_stack);
+    free(search);
 }
 
 /*
- * chesscat_moves_into_check
+ * _chesscat_run_thread
  *
- * Returns whether the given move moves into check in the given position
+ * Runs one thread's iterative deepening loop. Takes and returns void pointers so that it can start a thread
  */
-bool chesscat_moves_into_check(chesscat_Position *position, chesscat_Move move)
+void *_chesscat_run_thread(void *arg)
 {
-    if (_chesscat_position_ignores_checks(position))
+    chesscat_Search *search = arg;
+    if (search->shared->multi_player)
     {
-        return false;
+        _chesscat_iterate_multi(search);
     }
-
-    chesscat_Position position_copy = *position;
-
-    chesscat_make_move(&position_copy, move, Pawn);
-
-    return _chesscat_can_royal_be_captured(&position_copy);
+    else
+    {
+        _chesscat_iterate(search);
+    }
+    return NULL;
 }
 
 /*
- * chesscat_is_move_legal
+ * _chesscat_run_search
  *
- * Returns whether the given move is legal in the given position
- * Does not check if a move is actually *possible* - assumes it is
+ * Lazy SMP: runs limits->num_threads searches of the same root at once, sharing only the transposition table and a stop
+ * flag. Helper threads stagger their depths and fill the table with results the main thread then reuses. Once the main
+ * thread stops, the helpers are stopped too and the result comes from the thread with the deepest completed iteration.
+ * Without thread support every search runs on the calling thread only. Returns false if no search could be allocated
  */
-bool chesscat_is_move_legal(chesscat_Position *position, chesscat_Move move, chesscat_EPieceType promotion)
-{ // Check if a move meets qualifications to be legal. Does not check if it is POSSIBLE
-    chesscat_MovePromotion move_p = {.move = move, .promotion = promotion};
-    if (chesscat_moves_into_check(position, move_p.move))
+bool _chesscat_run_search(chesscat_Position *position, chesscat_TranspositionTable *tt, chesscat_SearchLimits *limits, _chesscat_SearchShared *shared, chesscat_SearchResult *result)
+{
+    uint16_t num_threads = limits->num_threads > 1 ? limits->num_threads : 1;
+    if (num_threads > CHESSCAT_MAX_THREADS)
     {
-        return false;
+        num_threads = CHESSCAT_MAX_THREADS;
     }
-    chesscat_Piece moving = chesscat_get_piece_at_square(position, move_p.move.from);
-    if (moving.type == Pawn && _chesscat_square_on_promotion_rank(position, move_p.move.to, position->to_move))
+#ifndef CHESSCAT_HAS_THREADS
+    num_threads = 1;
+#endif
+    shared->stop = false;
+    shared->nodes = 0;
+    shared->start_time = _chesscat_search_time();
+
+    chesscat_Search *searches[CHESSCAT_MAX_THREADS];
+    for (uint16_t i = 0; i < num_threads; i++)
     {
-        // Promotes
-        if (move_p.promotion == King || move_p.promotion == Empty)
+        searches[i] = _chesscat_new_search(position, tt, limits, shared, i);
+        if (searches[i] == NULL)
         {
-            return false;
+            num_threads = i;
+            break;
         }
     }
-    if(_chesscat_move_castles(position, move) != NotCastle){
-        if(chesscat_is_position_check(position)){
-            return false;
-        }
-        //NOTE: Maybe make this its own function?
-        chesscat_Square castle_step_square = move.from;
-        int8_t col_dif = move.to.col - move.from.col;
-        int8_t row_dif = move.to.row - move.from.row;
-        if(col_dif < 0){
-            castle_step_square.col--;
-        }
-        else if(col_dif > 0){
-            castle_step_square.col++;
-        }
-        else if(row_dif < 0){
-            castle_step_square.row--;
-        }
-        else if(row_dif > 0){
-            castle_step_square.row++;
-        }
-        chesscat_Move castle_step_move = {.from = move.from, .to = castle_step_square};
-        if(!chesscat_is_move_legal(position, castle_step_move, Queen)){
-            return false;
-        }
+    if (num_threads == 0)
+    {
+        return false;
+    }
+    if (tt != NULL)
+    {
+        chesscat_tt_new_search(tt);
     }
-    return true;
-}
-
-bool chesscat_is_move_possible(chesscat_Position *position, chesscat_Move move){
-    chesscat_Move moves[chesscat_get_possible_moves_from(position, move.from, NULL)];
-    uint16_t num_moves = chesscat_get_possible_moves_from(position, move.from, moves); //TODO: Make this more efficient
 
-    for(uint16_t i = 0; i < num_moves; i++){
-        if(_chesscat_same_move(moves[i], move)){
-            return true;
+#ifdef CHESSCAT_HAS_THREADS
+    pthread_t threads[CHESSCAT_MAX_THREADS];
+    bool started[CHESSCAT_MAX_THREADS] = {false};
+    for (uint16_t i = 1; i < num_threads; i++)
+    {
+        started[i] = pthread_create(&(threads[i]), NULL, _chesscat_run_thread, searches[i]) == 0;
+    }
+#endif
+    _chesscat_run_thread(searches[0]);
+    __atomic_store_n(&(shared->stop), true, __ATOMIC_RELAXED);
+#ifdef CHESSCAT_HAS_THREADS
+    for (uint16_t i = 1; i < num_threads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
         }
     }
+#endif
 
-    return false;
+    uint16_t best = 0;
+    for (uint16_t i = 1; i < num_threads; i++)
+    {
+        if (searches[i]->result.best_move != CHESSCAT_NO_MOVE && searches[i]->result.depth > searches[best]->result.depth)
+        {
+            best = i;
+        }
+    }
+    *result = searches[best]->result;
+    result->nodes = 0;
+    result->num_threads = num_threads;
+    result->seconds = _chesscat_search_time() - shared->start_time;
+    result->tt_probes = 0;
+    result->tt_hits = 0;
+    result->pawn_probes = 0;
+    result->pawn_hits = 0;
+    result->eval_probes = 0;
+    result->eval_hits = 0;
+    result->cutoffs = 0;
+    result->first_move_cutoffs = 0;
+    for (uint16_t i = 0; i < num_threads; i++)
+    {
+        result->thread_nodes[i] = searches[i]->nodes;
+        result->nodes += searches[i]->nodes;
+        result->tt_probes += searches[i]->tt_stats.probes;
+        result->tt_hits += searches[i]->tt_stats.hits;
+        result->pawn_probes += searches[i]->pawn_table.probes;
+        result->pawn_hits += searches[i]->pawn_table.hits;
+        result->eval_probes += searches[i]->eval_probes;
+        result->eval_hits += searches[i]->eval_hits;
+        result->cutoffs += searches[i]->ordering.cutoffs;
+        result->first_move_cutoffs += searches[i]->ordering.first_move_cutoffs;
+        _chesscat_free_search(searches[i]);
+    }
+    return true;
 }
 
 /*
- * chesscat_get_all_legal_moves
+ * chesscat_search
  *
- * Writes all legal moves for the current color to play to moves_buf
+ * Searches a position for the color to play's best move by iterative deepening until the limits are reached, and
+ * writes the result of the deepest completed iteration to result. Assumes a two-player game; see chesscat_search_multi.
+ * Searches with limits->num_threads threads, all sharing tt. tt may be NULL, and is shared with the caller so that it
+ * can be kept between searches. The position is not changed. Returns false if the search's memory could not be allocated
  */
-uint16_t chesscat_get_all_legal_moves(chesscat_Position *position, chesscat_Move moves_buf[]){
-    chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)]; //TODO: Make this more efficient
-    uint16_t num_possible_moves = chesscat_get_all_possible_moves(position, moves);
-    uint16_t num_legal_moves = 0;
-    for(uint16_t i = 0; i < num_possible_moves; i++){
-        if(chesscat_is_move_legal(position, moves[i], Queen)){
-            if(moves_buf != NULL){
-                moves_buf[num_legal_moves] = moves[i];
-            }
-            num_legal_moves++;
-        }
-    }
-    return num_legal_moves;
-}
-
-uint16_t chesscat_get_legal_moves_from(chesscat_Position *position, chesscat_Square from, chesscat_Move moves_buf[]){
-    chesscat_Move moves[chesscat_get_possible_moves_from(position, from, NULL)]; //TODO: Make this more efficient
-    uint16_t num_possible_moves = chesscat_get_possible_moves_from(position, from, moves);
-    uint16_t num_legal_moves = 0;
-    for(uint16_t i = 0; i < num_possible_moves; i++){
-        if(chesscat_is_move_legal(position, moves[i], Queen)){
-            if(moves_buf != NULL){
-                moves_buf[num_legal_moves] = moves[i];
-            }
-            num_legal_moves++;
-        }
-    }
-    return num_legal_moves;
+bool chesscat_search(chesscat_Position *position, chesscat_TranspositionTable *tt, chesscat_SearchLimits *limits, chesscat_SearchResult *result)
+{
+    _chesscat_SearchShared shared = {.multi_player = false};
+    return _chesscat_run_search(position, tt, limits, &shared, result);
 }
 
-chesscat_EPositionState chesscat_get_current_state(chesscat_Position *position){
-    bool isCheck = chesscat_is_position_check(position);
-
-    chesscat_Move moves[chesscat_get_all_legal_moves(position, NULL)];
-    uint16_t num_legal_moves = chesscat_get_all_legal_moves(position, moves); //TODO: Make this more efficient
-
-    bool noLegalMoves = (num_legal_moves == 0);
-
-    if(_chesscat_position_ignores_checks(position)){
-        if(position->game_rules.capture_all){
-            if(_chesscat_count_pieces(position, position->to_move) == 0){
-                return Checkmated;
-            }
-            else if(noLegalMoves){
-                return Stalemated;
-            }
-        }
-        else if(!_chesscat_has_royal(position, position->to_move)){
-            return Checkmated;
-        }
-    }
-    else{
-        if(noLegalMoves && isCheck){
-            return Checkmated;
-        }
-        if(noLegalMoves){
-            return Stalemated;
-        }
-        if(isCheck){
-            return Checked;
-        }
-    }
-    //TODO: Add lack of material draws
-    return Normal;
+/*
+ * chesscat_search_multi
+ *
+ * Searches a position with any number of colors for the color to play's best move with the given algorithm, deepening
+ * iteratively until the limits are reached. The result's scores hold each color's expected share of
+ * CHESSCAT_MULTI_TOTAL_SCORE at the end of the principal variation, and its score the color to play's share.
+ * Leaves are scored statically, without a quiescence search. Searches with limits->num_threads threads, and tt, which
+ * may be NULL, only supplies move ordering. The position is not changed. Returns false if the search's memory could not be allocated
+ */
+bool chesscat_search_multi(chesscat_Position *position, chesscat_TranspositionTable *tt, chesscat_EMultiPlayerAlgorithm algorithm, chesscat_SearchLimits *limits, chesscat_SearchResult *result)
+{
+    _chesscat_SearchShared shared = {.multi_player = true, .algorithm = algorithm};
+    return _chesscat_run_search(position, tt, limits, &shared, result);
 }
 
 /*   chesscat_Game utility functions   */
@@ -1526,8 +5659,8 @@ len_2:
     if (read_pos == 0)
     {
         // Iterate through possible moves, only one should result in this destination square and be a pawn move.
-        chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)];
-        uint16_t num_moves = chesscat_get_all_possible_moves(position, moves); // TODO: Make this more efficient
+        chesscat_Move moves[CHESSCAT_MAX_MOVES_TO_SQUARE];
+        uint16_t num_moves = _chesscat_get_possible_moves_to(position, to_square, moves);
 
         for (uint16_t i = 0; i < num_moves; i++)
         {
@@ -1587,8 +5720,8 @@ len_2:
             return move_p_final;
         }
 
-        chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)];
-        uint16_t num_moves = chesscat_get_all_possible_moves(position, moves); // TODO: Make this more efficient
+        chesscat_Move moves[CHESSCAT_MAX_MOVES_TO_SQUARE];
+        uint16_t num_moves = _chesscat_get_possible_moves_to(position, to_square, moves);
 
         for (uint16_t i = 0; i < num_moves; i++)
         {
@@ -1640,8 +5773,8 @@ len_2:
             }
 
             // Iterate through moves to find those with matching cols and piece types
-            chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)];
-            uint16_t num_moves = chesscat_get_all_possible_moves(position, moves); // TODO: Make this more efficient
+            chesscat_Move moves[CHESSCAT_MAX_MOVES_TO_SQUARE];
+            uint16_t num_moves = _chesscat_get_possible_moves_to(position, to_square, moves);
 
             for (uint16_t i = 0; i < num_moves; i++)
             {
@@ -1687,8 +5820,8 @@ len_2:
             }
 
             // Iterate through moves to find those with matching cols or piece types, and matching rows
-            chesscat_Move moves[chesscat_get_all_possible_moves(position, NULL)];
-            uint16_t num_moves = chesscat_get_all_possible_moves(position, moves); // TODO: Make this more efficient
+            chesscat_Move moves[CHESSCAT_MAX_MOVES_TO_SQUARE];
+            uint16_t num_moves = _chesscat_get_possible_moves_to(position, to_square, moves);
 
             for (uint16_t i = 0; i < num_moves; i++)
             {
@@ -1787,6 +5920,8 @@ void _chesscat_set_default_rules(chesscat_GameRules *rules)
     rules->capture_own = false;
     rules->sideways_pawns = false;
     rules->kangaroo_pawns = false;
+    rules->torpedo_pawns = false;
+    rules->use_mailbox = false;
 }
 
 void chesscat_set_default_game(chesscat_Game *game)
@@ -1807,6 +5942,7 @@ void chesscat_set_default_game(chesscat_Game *game)
     chesscat_Piece empty = {.color = White, .is_royal = false, .type = Empty};
 
     _chesscat_set_default_rules(&(game->position.game_rules));
+    _chesscat_clear_board(&(game->position));
     for (uint8_t col = 0; col <= 7; col++)
     {
         _chesscat_set_piece(&(game->position), 1, col, wPawn);
@@ -1854,6 +5990,81 @@ void chesscat_set_default_game(chesscat_Game *game)
     game->position.color_data[Green].is_in_game = false;
 
     game->position.to_move = White;
+    _chesscat_set_castle_rooks(&(game->position));
+    game->position.hash = chesscat_compute_hash(&(game->position));
+
+    chesscat_get_geometry(game->position.game_rules.board_width, game->position.game_rules.board_height);
+}
+
+/*
+ * chesscat_set_four_color_game
+ *
+ * Sets a game to a four-player starting position on a 14x14 board: White along the bottom edge and Black along
+ * the top as in chess, and Green along the left edge facing Red along the right. White plays first.
+ * Unlike standard four-player chess, the 3x3 corners of the board are not cut off but left empty and playable,
+ * so perft counts and best moves differ from those of the standard game
+ */
+void chesscat_set_four_color_game(chesscat_Game *game)
+{
+    const chesscat_EPieceType back_rank[8] = {Rook, Knight, Bishop, Queen, King, Bishop, Knight, Rook};
+    chesscat_Position *position = &(game->position);
+
+    _chesscat_set_default_rules(&(position->game_rules));
+    position->game_rules.board_width = 14;
+    position->game_rules.board_height = 14;
+    _chesscat_clear_board(position);
+    chesscat_get_geometry(position->game_rules.board_width, position->game_rules.board_height);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        bool is_royal = back_rank[i] == King;
+        chesscat_Piece white = {.color = White, .is_royal = is_royal, .type = back_rank[i]};
+        chesscat_Piece black = {.color = Black, .is_royal = is_royal, .type = back_rank[i]};
+        chesscat_Piece green = {.color = Green, .is_royal = is_royal, .type = back_rank[i]};
+        chesscat_Piece red = {.color = Red, .is_royal = is_royal, .type = back_rank[i]};
+        _chesscat_set_piece(position, 0, 3 + i, white);
+        _chesscat_set_piece(position, 13, 3 + i, black);
+        _chesscat_set_piece(position, 3 + i, 0, green);
+        _chesscat_set_piece(position, 3 + i, 13, red);
+
+        chesscat_Piece wPawn = {.color = White, .is_royal = false, .type = Pawn};
+        chesscat_Piece bPawn = {.color = Black, .is_royal = false, .type = Pawn};
+        chesscat_Piece gPawn = {.color = Green, .is_royal = false, .type = Pawn};
+        chesscat_Piece rPawn = {.color = Red, .is_royal = false, .type = Pawn};
+        _chesscat_set_piece(position, 1, 3 + i, wPawn);
+        _chesscat_set_piece(position, 12, 3 + i, bPawn);
+        _chesscat_set_piece(position, 3 + i, 1, gPawn);
+        _chesscat_set_piece(position, 3 + i, 12, rPawn);
+    }
+
+    chesscat_Square none = {.row = -1, .col = -1};
+    position->passantable_square = none;
+    for (uint8_t color = 0; color < CHESSCAT_NUM_COLORS; color++)
+    {
+        position->num_checks[color] = 0;
+        position->color_data[color].is_in_game = true;
+        position->color_data[color].has_king_moved = false;
+        position->color_data[color].has_lower_rook_moved = false;
+        position->color_data[color].has_upper_rook_moved = false;
+    }
+
+    position->to_move = White;
+    _chesscat_set_castle_rooks(position);
+    position->hash = chesscat_compute_hash(position);
+}
+
+/*
+ * chesscat_set_variant_rules
+ *
+ * Turns each variant rule on or off by the CHESSCAT_RULE_ flags in rules, and rehashes the position, whose hash
+ * includes the rules
+ */
+void chesscat_set_variant_rules(chesscat_Position *position, uint8_t rules)
+{
+    position->game_rules.sideways_pawns = rules & CHESSCAT_RULE_SIDEWAYS_PAWNS;
+    position->game_rules.kangaroo_pawns = rules & CHESSCAT_RULE_KANGAROO_PAWNS;
+    position->game_rules.torpedo_pawns = rules & CHESSCAT_RULE_TORPEDO_PAWNS;
+    position->game_rules.capture_own = rules & CHESSCAT_RULE_CAPTURE_OWN;
+    position->hash = chesscat_compute_hash(position);
 }
 
 /*
@@ -1910,6 +6121,7 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
             if(nextcharnum <= 9){ //If next char is a number too
                 emptyrows *= 10;
                 emptyrows += nextcharnum;
+                charpos++;
             }
             for(uint8_t i = 0; i < emptyrows; i++){
                 chesscat_Piece empty_piece = {.color = White, .is_royal = false, .type = Empty};
@@ -1920,6 +6132,10 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
         }
         goto fen_error; //Char doesn't match any valid char at this point
     }
+    _chesscat_clear_board(&(game->position)); //Remove the default pieces, including any outside the new board size
+    if(chesscat_get_geometry(game->position.game_rules.board_width, game->position.game_rules.board_height) == NULL){
+        goto oob_error;
+    }
     uint8_t real_row = 0;
     for(int16_t rowpos = game->position.game_rules.board_height - 1; rowpos >= 0; rowpos--){
         for(uint8_t colpos = 0; colpos < game->position.game_rules.board_width; colpos++){
@@ -1927,6 +6143,7 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
         }
         real_row++;
     }
+    _chesscat_set_castle_rooks(&(game->position));
 
     while(FEN[charpos] == ' '){ //Ignore whitespace
         charpos++;
@@ -1934,6 +6151,7 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
 
     if(FEN[charpos] == '\0'){
         //Incomplete FEN, return default state
+        game->position.hash = chesscat_compute_hash(&(game->position));
         return 0;
     }
 
@@ -1974,6 +6192,11 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
         }
     }
     else{
+        game->position.color_data[White].has_lower_rook_moved = true;
+        game->position.color_data[White].has_upper_rook_moved = true;
+
+        game->position.color_data[Black].has_lower_rook_moved = true;
+        game->position.color_data[Black].has_upper_rook_moved = true;
         charpos++;
     }
 
@@ -1994,13 +6217,13 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
         }
         game->position.passantable_square = passant_square;
         game->position.passant_target_square = passant_square;
-        if(game->position.to_move == White){
-            game->position.passant_target_square.row++;
+        if(game->position.to_move == White){ //The pawn to take is one row past the square, from the mover's side
+            game->position.passant_target_square.row--;
         }
         else{
-            game->position.passant_target_square.row--;
+            game->position.passant_target_square.row++;
         }
-        while(FEN[charpos] != ' '){ //Ignore whitespace
+        while(FEN[charpos] != ' ' && FEN[charpos] != '\0'){ //Skip past the square
             charpos++;
         }
     }
@@ -2010,6 +6233,7 @@ uint8_t chesscat_set_game_to_FEN(chesscat_Game *game, char* FEN){
 
     //TODO: 50-move rule counter
 
+    game->position.hash = chesscat_compute_hash(&(game->position));
     return 0;
 
 
@@ -1,11 +1,19 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define CHESSCAT_INCLUDE_MISC_H
 
 #define CHESSCAT_MIN_BITS_REQUIRED(value) ((sizeof(value) * 8) - __builtin_clz(value))
 
 #define CHESSCAT_MAX_BOARD_SIZE 23 //Max board width or height
+#define CHESSCAT_NUM_SQUARES (CHESSCAT_MAX_BOARD_SIZE * CHESSCAT_MAX_BOARD_SIZE) //Squares are indexed as row * CHESSCAT_MAX_BOARD_SIZE + col
+#define CHESSCAT_MAILBOX_PADDING 2 //Off-board border width of the mailbox board, enough for the longest leaper jump
+#define CHESSCAT_MAILBOX_STRIDE (CHESSCAT_MAX_BOARD_SIZE + 2 * CHESSCAT_MAILBOX_PADDING)
+#define CHESSCAT_MAILBOX_SIZE (CHESSCAT_MAILBOX_STRIDE * CHESSCAT_MAILBOX_STRIDE)
+#define CHESSCAT_MAILBOX_EMPTY 0
+#define CHESSCAT_MAILBOX_OFF_BOARD 0xFF //Sentinel for cells outside the board
+#define CHESSCAT_BITBOARD_WORDS ((CHESSCAT_NUM_SQUARES + 63) / 64) //Number of 64-bit words needed to hold one bit per square
 
 #define CHESSCAT_NUM_COLORS 4 //Number of colors supported
 #define CHESSCAT_NUM_COLOR_BITS CHESSCAT_MIN_BITS_REQUIRED(CHESSCAT_NUM_COLORS - 1) //(Subtract 1 for 0-based numbering)
@@ -30,6 +38,8 @@ typedef enum /* : uint8_t*/{
     //Duck //Colorless
 } chesscat_EPieceType;
 
+#define CHESSCAT_NUM_PIECE_TYPES 7 //Including Empty
+
 typedef enum/* : uint8_t*/{
     White,
     Black,
@@ -37,11 +47,19 @@ typedef enum/* : uint8_t*/{
     Red
 } chesscat_EColor;
 
+typedef struct{
+    int8_t row;
+    int8_t col;
+} chesscat_Square;
+
 typedef struct {
     bool is_in_game;
     bool has_king_moved : 1;
     bool has_upper_rook_moved : 1;
     bool has_lower_rook_moved : 1;
+    uint16_t king_square; //Square index of one of this color's kings, CHESSCAT_NUM_SQUARES if it has none
+    chesscat_Square lower_rook_square; //Rook this color castles with towards lower coordinates, -1 -1 if none
+    chesscat_Square upper_rook_square; //Rook this color castles with towards higher coordinates, -1 -1 if none
 } _chesscat_ColorData;
 
 typedef struct {
@@ -51,9 +69,8 @@ typedef struct {
 } chesscat_Piece;
 
 typedef struct{
-    int8_t row;
-    int8_t col;
-} chesscat_Square;
+    uint64_t words[CHESSCAT_BITBOARD_WORDS]; //Bit (index % 64) of word (index / 64) is set for each square index in the set
+} chesscat_Bitboard;
 
 typedef struct{
     chesscat_Square from;
@@ -65,6 +82,102 @@ typedef struct{
     chesscat_EPieceType promotion;
 } chesscat_MovePromotion;
 
+typedef enum{
+    GenerateAll,
+    GenerateCaptures, //Captures, en passants and promotions
+    GenerateQuiets, //Every other move, including castles
+    GenerateChecks //Quiet moves that attack another color's royal piece
+} chesscat_EGenerationMode;
+
+typedef uint32_t chesscat_PackedMove; //Move with its pieces and flags packed into bits, see the CHESSCAT_MOVE_ defines
+
+#define CHESSCAT_MOVE_SQUARE_MASK 0x3FF //Square indices take 10 bits
+#define CHESSCAT_MOVE_TYPE_MASK 0x7 //Piece types take 3 bits
+#define CHESSCAT_MOVE_FROM_SHIFT 0
+#define CHESSCAT_MOVE_TO_SHIFT 10
+#define CHESSCAT_MOVE_PIECE_SHIFT 20 //Type of the moving piece
+#define CHESSCAT_MOVE_CAPTURED_SHIFT 23 //Type of the captured piece, Empty if none
+#define CHESSCAT_MOVE_PROMOTION_SHIFT 26 //Type promoted to, Empty if none
+#define CHESSCAT_MOVE_CASTLE_FLAG (1u << 29)
+#define CHESSCAT_MOVE_DOUBLE_PUSH_FLAG (1u << 30) //Pawn moved two squares, leaving an en passant square
+#define CHESSCAT_MOVE_PASSANT_FLAG (1u << 31) //En passant capture
+#define CHESSCAT_NO_MOVE 0
+
+typedef struct{
+    // Move targets for one board size, precomputed so that move generation needs no bounds checks.
+    // Tables are indexed by square index. Leaper and pawn target lists only hold on-board squares
+    uint8_t board_width;
+    uint8_t board_height;
+    uint8_t num_knight_targets[CHESSCAT_NUM_SQUARES];
+    chesscat_Square knight_targets[CHESSCAT_NUM_SQUARES][8];
+    uint8_t num_king_targets[CHESSCAT_NUM_SQUARES];
+    chesscat_Square king_targets[CHESSCAT_NUM_SQUARES][8];
+    uint8_t ray_lengths[CHESSCAT_NUM_SQUARES][8]; //Steps before the board edge in each direction of _chesscat_ray_steps
+    chesscat_Square pawn_push[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES]; //-1 -1 if off the board
+    chesscat_Square pawn_double_push[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES]; //-1 -1 if off the board
+    bool pawn_on_start_rank[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES]; //Whether a pawn may advance two squares from here
+    uint8_t num_pawn_captures[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES];
+    chesscat_Square pawn_captures[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES][2]; //Squares a pawn here captures on
+    uint8_t num_pawn_attackers[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES];
+    chesscat_Square pawn_attackers[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES][2]; //Squares a pawn captures here from
+    uint8_t num_pawn_sideways[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES];
+    chesscat_Square pawn_sideways[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES][2]; //Squares a sideways pawn here moves to
+    int16_t piece_squares[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_PIECE_TYPES][CHESSCAT_NUM_SQUARES]; //Positional bonus in centipawns, per color since each plays in its own direction
+} chesscat_Geometry;
+
+#define CHESSCAT_NUM_HASHED_RULES 8 //Game rules that change which moves are legal, see _chesscat_rules_key
+#define CHESSCAT_NUM_CASTLE_STATES 8 //Combinations of the three castling flags in _chesscat_ColorData
+#define CHESSCAT_NUM_PERFT_DEPTHS 256 //One per uint8_t depth
+
+typedef struct{
+    // Random keys XORed together into a position's Zobrist hash. Generated from a fixed seed, so hashes are the same on every run
+    uint64_t pieces[CHESSCAT_NUM_SQUARES][CHESSCAT_NUM_COLORS][CHESSCAT_NUM_PIECE_TYPES]; //Empty entries stay 0
+    uint64_t royal[CHESSCAT_NUM_SQUARES]; //XORed in along with the piece key for royal pieces
+    uint64_t to_move[CHESSCAT_NUM_COLORS];
+    uint64_t castling[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_CASTLE_STATES]; //Only colors still in the game are hashed
+    uint64_t passant[CHESSCAT_NUM_SQUARES];
+    uint64_t rules[CHESSCAT_NUM_HASHED_RULES];
+    uint64_t board_width[CHESSCAT_MAX_BOARD_SIZE + 1];
+    uint64_t board_height[CHESSCAT_MAX_BOARD_SIZE + 1];
+    uint64_t perft_depth[CHESSCAT_NUM_PERFT_DEPTHS]; //XORed into a position's hash to key its perft count at each depth
+} _chesscat_ZobristKeys;
+
+#define CHESSCAT_NNUE_MAGIC 0x4E4E4343 //"CCNN" read as a little-endian uint32_t
+#define CHESSCAT_NNUE_VERSION 1
+#define CHESSCAT_NNUE_HEADER_SIZE 64 //Bytes before the first layer, so that the layers stay 32-byte aligned in the mapped file
+#define CHESSCAT_NNUE_NUM_FEATURES (CHESSCAT_NUM_COLORS * (CHESSCAT_NUM_PIECE_TYPES - 1) * CHESSCAT_NUM_SQUARES) //(Color, piece type, square) as seen by one color
+#define CHESSCAT_NNUE_L1 256 //Accumulator width
+#define CHESSCAT_NNUE_L2 32
+#define CHESSCAT_NNUE_L3 32
+#define CHESSCAT_NNUE_ACTIVATION_MAX 127 //Clipped ReLU range of every layer's output
+#define CHESSCAT_NNUE_WEIGHT_SHIFT 6 //Dense layer sums are shifted right by this before clipping
+#define CHESSCAT_NNUE_OUTPUT_SCALE 16 //Network output units per centipawn
+
+typedef struct{
+    // Weights file header, followed by the layers in the order of the pointers in _chesscat_Network. All values are little-endian
+    uint32_t magic; //CHESSCAT_NNUE_MAGIC
+    uint32_t version; //CHESSCAT_NNUE_VERSION
+    uint32_t num_features; //Layer sizes, which must match the CHESSCAT_NNUE_ constants
+    uint32_t l1;
+    uint32_t l2;
+    uint32_t l3;
+} chesscat_NetworkHeader;
+
+typedef struct{
+    const int16_t *feature_weights; //[CHESSCAT_NNUE_NUM_FEATURES][CHESSCAT_NNUE_L1], added to an accumulator for each piece on the board
+    const int16_t *feature_biases; //[CHESSCAT_NNUE_L1]
+    const int8_t *hidden1_weights; //[CHESSCAT_NNUE_L2][CHESSCAT_NNUE_L1]
+    const int32_t *hidden1_biases; //[CHESSCAT_NNUE_L2]
+    const int8_t *hidden2_weights; //[CHESSCAT_NNUE_L3][CHESSCAT_NNUE_L2]
+    const int32_t *hidden2_biases; //[CHESSCAT_NNUE_L3]
+    const int8_t *output_weights; //[CHESSCAT_NNUE_L3]
+    const int32_t *output_bias; //[1]
+    void *memory; //The whole weights file
+    size_t size;
+    bool is_mapped; //Whether memory was mapped from the file rather than read into the heap
+    uint32_t id; //Changes with every load, so that positions can tell whether their accumulators are current. 0 if no network is loaded
+} _chesscat_Network;
+
 typedef struct{
     // --chesscat_Game-breaking rules--
     uint8_t board_width;
@@ -91,16 +204,40 @@ typedef struct{
     //bool has_duck; //🦆
     //bool atomic; //💥
 
+    // --Engine options--
+    bool use_mailbox; //Generate moves on the sentinel-padded mailbox board instead of the geometry tables
+
 } chesscat_GameRules;
 
+// Variant rules turned on by chesscat_set_variant_rules, combined with |
+#define CHESSCAT_RULE_SIDEWAYS_PAWNS 1
+#define CHESSCAT_RULE_KANGAROO_PAWNS 2
+#define CHESSCAT_RULE_TORPEDO_PAWNS 4
+#define CHESSCAT_RULE_CAPTURE_OWN 8
+
 typedef struct{
     chesscat_GameRules game_rules;
     chesscat_EColor to_move : CHESSCAT_NUM_COLOR_BITS;
     chesscat_Square passantable_square; //Should be set to -1 -1 if no square is available
     chesscat_Square passant_target_square; //The pawn to be taken if en passant happens
-    _chesscat_ColorData color_data[CHESSCAT_NUM_COLORS]; //Whether the king or rooks have moved
+    _chesscat_ColorData color_data[CHESSCAT_NUM_COLORS]; //Whether the king or rooks have moved, and where they are
     uint8_t num_checks[CHESSCAT_NUM_COLORS]; //Number of times this color has been checked
     chesscat_Piece board[CHESSCAT_MAX_BOARD_SIZE][CHESSCAT_MAX_BOARD_SIZE]; //0-based array of pieces in [row][col] order
+    chesscat_Bitboard occupied; //Squares holding any piece. Bitboards are kept in sync with board by _chesscat_set_piece
+    chesscat_Bitboard color_occupancy[CHESSCAT_NUM_COLORS]; //Squares holding a piece of each color
+    chesscat_Bitboard type_occupancy[CHESSCAT_NUM_PIECE_TYPES]; //Squares holding a piece of each type (Empty is unused)
+    chesscat_Bitboard royal_occupancy; //Squares holding a royal piece
+    uint16_t piece_list[CHESSCAT_NUM_COLORS][CHESSCAT_NUM_SQUARES]; //Square indices of each color's pieces, in no particular order
+    uint16_t piece_count[CHESSCAT_NUM_COLORS]; //Number of valid entries in piece_list for each color
+    uint16_t piece_list_index[CHESSCAT_NUM_SQUARES]; //Position of an occupied square's entry within its color's piece_list
+    uint16_t royal_count[CHESSCAT_NUM_COLORS]; //Number of royal pieces of each color
+    uint8_t mailbox[CHESSCAT_MAILBOX_SIZE]; //Board copy with an off-board border, one byte per cell. See _chesscat_mailbox_code
+    uint64_t hash; //Zobrist key, updated incrementally by moves. See chesscat_compute_hash
+    uint64_t pawn_hash; //Zobrist key of the pawns alone, updated by every board write. See chesscat_compute_pawn_hash
+    int32_t material[CHESSCAT_NUM_COLORS]; //Value of each color's non-royal pieces in centipawns, updated by every board write
+    int32_t piece_squares[CHESSCAT_NUM_COLORS]; //Sum of each color's piece-square bonuses from chesscat_Geometry, updated by every board write
+    int16_t accumulators[CHESSCAT_NUM_COLORS][CHESSCAT_NNUE_L1]; //First network layer as seen by each color, updated by every board write while current
+    uint32_t network_id; //_chesscat_Network id the accumulators were built for, 0 if they are not current. See chesscat_refresh_accumulators
     //chesscat_Piece captured_pieces[CHESSCAT_MAX_BOARD_SIZE * CHESSCAT_MAX_BOARD_SIZE];
 } chesscat_Position;
 
@@ -112,6 +249,245 @@ typedef struct{
     chesscat_EPieceType promotions[CHESSCAT_MAX_BOARD_SIZE * CHESSCAT_MAX_BOARD_SIZE]; //Pawn promotions
 } chesscat_Game;
 
+#define CHESSCAT_MAX_MOVES_FROM_SQUARE (4 * (CHESSCAT_MAX_BOARD_SIZE - 1)) //A queen in the middle of the largest board has the most moves
+#define CHESSCAT_MAX_PAWN_MOVES_FROM_SQUARE 24 //Push, double push, two captures and two sideways steps, each promoting four ways
+#define CHESSCAT_MAX_MOVES_TO_SQUARE 17 //8 leaps, the nearest piece along each of the 8 rays, and a pawn jumping over one of them
+#define CHESSCAT_MAX_MOVES (CHESSCAT_NUM_SQUARES * CHESSCAT_MAX_MOVES_FROM_SQUARE) //Most moves in any position. See chesscat_get_max_moves for a bound per rule set
+#define CHESSCAT_MAX_PINS 8 //One per ray from the royal piece
+
+typedef struct{
+    bool enabled; //False when the position needs the slower make-and-test legality check
+    chesscat_Square royal_square;
+    uint8_t num_checkers;
+    chesscat_Bitboard check_mask; //With one checker, the squares a non-royal move must land on to stop the check
+    uint8_t num_pins;
+    chesscat_Square pinned[CHESSCAT_MAX_PINS];
+    chesscat_Square pinners[CHESSCAT_MAX_PINS]; //Piece pinning each pinned piece, the far end of the line it may move along
+    int8_t pin_row_step[CHESSCAT_MAX_PINS]; //Direction from the royal piece towards the pinned piece
+    int8_t pin_col_step[CHESSCAT_MAX_PINS];
+} _chesscat_LegalityInfo;
+
+#define CHESSCAT_MAX_UNDO_SQUARES 6 //Most board writes a single move can make (castling writes 4, a capturing promotion 3)
+
+typedef struct{
+    uint8_t num_squares;
+    chesscat_Square squares[CHESSCAT_MAX_UNDO_SQUARES]; //Squares written by the move, in write order
+    chesscat_Piece pieces[CHESSCAT_MAX_UNDO_SQUARES]; //What each square held before it was written
+    _chesscat_ColorData color_data[CHESSCAT_NUM_COLORS];
+    chesscat_Square passantable_square;
+    chesscat_Square passant_target_square;
+    chesscat_EColor to_move : CHESSCAT_NUM_COLOR_BITS;
+    uint64_t hash;
+} chesscat_MoveUndo;
+
+#define CHESSCAT_NUM_KILLERS 2 //Killer moves tried per search ply
+#define CHESSCAT_HISTORY_MAX 16384 //History scores stay within plus or minus this. See _chesscat_history_bonus
+#define CHESSCAT_MAX_QUIETS_TRIED 64 //Quiet moves per node whose history is lowered when a later move causes a cutoff
+#define CHESSCAT_SEE_MAX_EXCHANGES 64 //Captures on one square followed by chesscat_see
+
+typedef struct{
+    // Move-ordering heuristics learned as a search goes. Each search thread has its own
+    int16_t history[CHESSCAT_NUM_SQUARES][CHESSCAT_NUM_SQUARES]; //Butterfly table of quiet moves by from and to square, raised by cutoffs and lowered for moves tried before one
+    chesscat_PackedMove counter_moves[CHESSCAT_NUM_SQUARES][CHESSCAT_NUM_SQUARES]; //Quiet move that last refuted a move, by that move's from and to square
+    uint64_t cutoffs; //Beta cutoffs recorded, and how many of them the first move searched caused
+    uint64_t first_move_cutoffs;
+} chesscat_MoveOrdering;
+
+typedef enum{
+    PickHashMove,
+    PickGenerateCaptures,
+    PickGoodCaptures,
+    PickPromotions,
+    PickKillers,
+    PickCounterMove,
+    PickGenerateQuiets,
+    PickQuiets,
+    PickBadCaptures,
+    PickDone
+} _chesscat_EPickStage;
+
+typedef struct{
+    chesscat_Position *position;
+    _chesscat_LegalityInfo info;
+    _chesscat_EPickStage stage;
+    chesscat_PackedMove hash_move; //CHESSCAT_NO_MOVE if none
+    chesscat_PackedMove killers[CHESSCAT_NUM_KILLERS]; //CHESSCAT_NO_MOVE if none
+    uint8_t killer_index;
+    chesscat_MoveOrdering *ordering; //NULL to leave quiet moves in generation order. See chesscat_set_picker_ordering
+    chesscat_PackedMove counter_move; //CHESSCAT_NO_MOVE if none
+    bool captures_only; //Stop after the winning captures and promotions, as quiescence search wants
+    chesscat_PackedMove *moves; //Caller's buffer, filled with captures once the hash move has been tried, and quiets once the killers have
+    uint16_t max_moves;
+    uint16_t num_moves;
+    uint16_t current; //Next move to look at in the current stage
+    uint16_t captures_end; //moves holds captures, then promotions, then quiet moves
+    uint16_t promotions_end;
+    uint16_t bad_captures_end; //Losing captures are moved to the front of moves to be tried last
+} chesscat_MovePicker;
+
+#define CHESSCAT_TT_CLUSTER_SIZE 4 //Entries per bucket: one 64-byte cache line
+#define CHESSCAT_TT_DEPTH_SLOTS (CHESSCAT_TT_CLUSTER_SIZE - 1) //Depth-preferred entries per bucket. The last entry is always replaced
+#define CHESSCAT_TT_GENERATION_BITS 6
+#define CHESSCAT_TT_HUGE_PAGE_SIZE (2 * 1024 * 1024) //Huge-page-backed tables are rounded up to a multiple of this
+#define CHESSCAT_TT_FILL_SAMPLE 1000 //Clusters sampled by chesscat_tt_fill_permille
+
+// Bit layout of a transposition table entry's data. Search entries hold a move and score, perft entries a leaf count
+#define CHESSCAT_TT_DEPTH_SHIFT 0
+#define CHESSCAT_TT_BOUND_SHIFT 8
+#define CHESSCAT_TT_GENERATION_SHIFT 10
+#define CHESSCAT_TT_SCORE_SHIFT 16
+#define CHESSCAT_TT_MOVE_SHIFT 32
+#define CHESSCAT_TT_NODES_SHIFT 16
+#define CHESSCAT_TT_MAX_NODES ((1ull << (64 - CHESSCAT_TT_NODES_SHIFT)) - 1) //Larger perft counts are not stored
+
+typedef enum{
+    BoundNone, //Empty entry
+    BoundExact,
+    BoundLower, //Score failed high, the real score is at least this
+    BoundUpper //Score failed low, the real score is at most this
+} chesscat_EBound;
+
+typedef struct{
+    chesscat_PackedMove move; //CHESSCAT_NO_MOVE if none
+    int16_t score;
+    uint8_t depth;
+    chesscat_EBound bound;
+} chesscat_TTEntry;
+
+typedef struct{
+    // Written and read without locks. The key is stored XORed with the data, so an entry torn by two threads writing
+    // at once no longer matches its hash and is treated as a miss
+    uint64_t key_xor_data;
+    uint64_t data;
+} _chesscat_TTSlot;
+
+typedef struct{
+    _chesscat_TTSlot slots[CHESSCAT_TT_CLUSTER_SIZE];
+} _chesscat_TTCluster;
+
+typedef struct{
+    _chesscat_TTCluster *clusters;
+    uint64_t num_clusters; //Always a power of two
+    size_t size; //Bytes allocated for clusters
+    bool is_mapped; //Whether clusters were allocated with mmap rather than malloc
+    bool uses_huge_pages;
+    uint8_t generation; //Bumped by chesscat_tt_new_search so that entries from older searches are replaced first
+} chesscat_TranspositionTable;
+
+typedef struct{
+    // Kept by each thread probing a table rather than in the shared table, so threads do not contend on one cache line
+    uint64_t probes;
+    uint64_t hits;
+} chesscat_TTStats;
+
+#define CHESSCAT_PAWN_TABLE_SIZE 4096 //Entries in each search thread's pawn table, a power of two
+#define CHESSCAT_EVAL_CACHE_SIZE 8192 //Entries in each search thread's eval cache, a power of two
+#define CHESSCAT_DOUBLED_PAWN_PENALTY 12 //For each pawn sharing its file with another pawn of its color
+#define CHESSCAT_ISOLATED_PAWN_PENALTY 10 //For each pawn with no pawn of its color on a neighbouring file
+#define CHESSCAT_PASSED_PAWN_BONUS 10 //For each pawn with no enemy pawn ahead of it on its own or a neighbouring file
+#define CHESSCAT_PASSED_PAWN_ADVANCE_BONUS 60 //Added to a passed pawn's bonus in proportion to how far it has advanced
+
+typedef struct{
+    // Files and ranks are taken along each color's direction of play, so Green and Red files are rows
+    uint64_t key; //Pawn table key of the position scored, see _chesscat_pawn_table_key. 0 for an empty entry
+    int16_t scores[CHESSCAT_NUM_COLORS]; //Pawn-structure score of each color in centipawns
+    chesscat_Bitboard passed[CHESSCAT_NUM_COLORS]; //Each color's passed pawns
+} chesscat_PawnEntry;
+
+typedef struct{
+    // Not thread-safe: each search thread has its own
+    chesscat_PawnEntry *entries; //CHESSCAT_PAWN_TABLE_SIZE entries, replaced whenever another pawn structure needs the slot
+    uint64_t probes;
+    uint64_t hits;
+} chesscat_PawnTable;
+
+typedef struct{
+    uint64_t key; //Full position hash
+    int16_t score;
+    bool is_valid;
+} _chesscat_EvalCacheEntry;
+
+#define CHESSCAT_MAX_PLY 64 //Deepest the search reaches from the root, quiescence plies included
+#define CHESSCAT_MATE_SCORE 32000 //Score for mating at the root. Mating in n plies scores CHESSCAT_MATE_SCORE - n
+#define CHESSCAT_INFINITE_SCORE 32001
+#define CHESSCAT_MATE_BOUND (CHESSCAT_MATE_SCORE - CHESSCAT_MAX_PLY) //Scores at least this far from 0 are mates
+#define CHESSCAT_ASPIRATION_WINDOW 25 //Half width of the first aspiration window around the last score, in centipawns
+#define CHESSCAT_ASPIRATION_DEPTH 4 //First iteration searched with an aspiration window
+#define CHESSCAT_SEARCH_CHECK_NODES 1024 //Nodes a search thread searches between looks at the clock and the stop flag. Must be a power of two
+#define CHESSCAT_MAX_THREADS 64
+#define CHESSCAT_NUM_SKIP_PATTERNS 20 //Depth-skipping patterns for helper threads. See _chesscat_skip_depth
+
+#define CHESSCAT_MULTI_TOTAL_SCORE 1000 //Multi-player searches share this score out between the colors
+#define CHESSCAT_MULTI_ALIVE_VALUE 1000 //Centipawns counted for each color still playing when sharing out scores, so that knocking a color out is worth more than material
+
+typedef enum{
+    Paranoid, //Every other color plays against the color to play
+    MaxN, //Every color plays for its own score
+    BestReply //The color to play's moves alternate with the single strongest reply of any other color
+} chesscat_EMultiPlayerAlgorithm;
+
+typedef struct{
+    uint8_t depth; //Deepest iteration to run, 0 for no limit
+    uint64_t nodes; //Nodes to stop after, 0 for no limit
+    uint32_t time_ms; //Milliseconds to stop after, 0 for no limit
+    uint16_t num_threads; //Threads to search with, 0 or 1 for the calling thread only
+} chesscat_SearchLimits;
+
+typedef struct{
+    chesscat_PackedMove best_move; //CHESSCAT_NO_MOVE if the color to play has no legal move
+    int16_t score; //Centipawns for the color to play, or a mate score. See CHESSCAT_MATE_BOUND. Multi-player searches give the color to play's share instead
+    int16_t scores[CHESSCAT_NUM_COLORS]; //Multi-player searches only: each color's share of CHESSCAT_MULTI_TOTAL_SCORE
+    uint8_t depth; //Deepest completed iteration
+    uint64_t nodes; //Searched by all threads
+    double seconds;
+    uint8_t pv_length;
+    chesscat_PackedMove pv[CHESSCAT_MAX_PLY]; //Principal variation, starting with best_move
+    uint16_t num_threads; //Threads that searched
+    uint64_t thread_nodes[CHESSCAT_MAX_THREADS]; //Nodes searched by each thread, the main thread first
+    uint64_t tt_probes; //Transposition table, pawn table and eval cache statistics, summed over every thread
+    uint64_t tt_hits;
+    uint64_t pawn_probes;
+    uint64_t pawn_hits;
+    uint64_t eval_probes;
+    uint64_t eval_hits;
+    uint64_t cutoffs; //Beta cutoffs, and how many of them the first move searched caused, summed over every thread
+    uint64_t first_move_cutoffs;
+} chesscat_SearchResult;
+
+typedef struct{
+    // State shared by every thread of a search
+    bool stop; //Set once the main thread has stopped, to stop the helpers
+    uint64_t nodes; //Nodes searched by all threads, added in batches of CHESSCAT_SEARCH_CHECK_NODES
+    double start_time;
+    bool multi_player;
+    chesscat_EMultiPlayerAlgorithm algorithm; //For multi-player searches
+} _chesscat_SearchShared;
+
+typedef struct{
+    chesscat_Position position; //Copy of the root, played forward and back as the search goes
+    chesscat_EColor root_color; //Color the search is choosing a move for
+    chesscat_TranspositionTable *tt; //May be NULL. Shared by every thread
+    chesscat_TTStats tt_stats; //This thread's probes of tt
+    chesscat_SearchLimits limits;
+    _chesscat_SearchShared *shared;
+    uint16_t thread_index; //0 for the main thread, which stops the search
+    uint64_t nodes;
+    bool stopped;
+    uint16_t max_moves;
+    chesscat_PackedMove *move_stack; //One buffer of max_moves moves per ply
+    chesscat_PackedMove killers[CHESSCAT_MAX_PLY][CHESSCAT_NUM_KILLERS]; //Quiet moves that caused a cutoff at each ply
+    chesscat_MoveOrdering ordering;
+    chesscat_PackedMove played[CHESSCAT_MAX_PLY]; //Move made at each ply, whose counter move the next ply tries
+    uint64_t path_hashes[CHESSCAT_MAX_PLY]; //Hashes of the positions from the root to the current ply, to spot repetitions
+    uint8_t pv_length[CHESSCAT_MAX_PLY];
+    chesscat_PackedMove pv[CHESSCAT_MAX_PLY][CHESSCAT_MAX_PLY]; //Triangular table: pv[ply] holds the best line found from ply
+    chesscat_PawnTable pawn_table; //This thread's own
+    _chesscat_EvalCacheEntry *eval_cache; //CHESSCAT_EVAL_CACHE_SIZE static evaluations by position hash, this thread's own
+    uint64_t eval_probes;
+    uint64_t eval_hits;
+    chesscat_SearchResult result; //Updated after each completed iteration
+} chesscat_Search;
+
 typedef enum{
     NotCastle,
     LowerCastle,
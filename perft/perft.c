@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../libchesscat.h"
+
+/*
+ * Perft driver and move generation benchmark.
+ *
+ * Usage: perft [options] <depth> [FEN]
+ *   -d          Divide: print the count below each root move
+ *   -s          Run the reference suite instead of a single position
+ *   -m          Use the mailbox move generator
+ *   -t <MB>     Use a transposition table of this size
+ *   -j <N>      Count with N threads
+ *   -p <D>      With threads, split the tree into subtrees D moves deep (default 2)
+ *   -b          Also count by brute force, playing every possible move and testing it for check, and fail on a mismatch
+ *   --sideways, --kangaroo, --torpedo, --capture-own
+ *               Turn on variant rules for a single position
+ */
+
+#define MAX_SPLIT_DEPTH 8
+#define DEFAULT_SPLIT_DEPTH 2
+
+typedef struct
+{
+    const char *name;
+    const char *fen; // NULL for the four-color starting position
+    uint8_t rules; // CHESSCAT_RULE_ flags
+    uint8_t depth;
+    uint64_t nodes;
+} SuitePosition;
+
+// Standard chess counts are the published reference values. Variant and four-color counts come from this library.
+// They were checked with -b against chesscat_perft_brute_force, which tests every possible move by playing it instead of
+// using the checker and pin shortcuts that the geometry and mailbox generators share
+static const SuitePosition suite[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0, 5, 4865609},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 0, 4, 4085603},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 0, 5, 674624},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 0, 4, 422333},
+    {"position 4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 0, 4, 422333},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 0, 4, 2103487},
+    {"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 0, 4, 3894594},
+    {"illegal en passant 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 0, 6, 1134888},
+    {"illegal en passant 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 0, 6, 1015133},
+    {"en passant gives check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 0, 6, 1440467},
+    {"short castle gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 0, 6, 661072},
+    {"long castle gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 0, 6, 803711},
+    {"castling rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 0, 4, 1274206},
+    {"castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 0, 4, 1720476},
+    {"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 0, 6, 3821001},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 0, 5, 1004658},
+    {"promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 0, 6, 217342},
+    {"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 0, 6, 92683},
+    {"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 0, 6, 2217},
+    {"stalemate and checkmate", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 0, 7, 567584},
+    {"double check", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 0, 4, 23527},
+    {"sideways pawns", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", CHESSCAT_RULE_SIDEWAYS_PAWNS, 4, 250185},
+    {"kangaroo and torpedo pawns", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", CHESSCAT_RULE_KANGAROO_PAWNS | CHESSCAT_RULE_TORPEDO_PAWNS, 4, 214170},
+    {"kangaroo pawn pinned", "4k3/8/8/8/8/4r3/4P3/4K3 w - - 0 1", CHESSCAT_RULE_KANGAROO_PAWNS, 5, 41393},
+    {"all pawn variants", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", CHESSCAT_RULE_SIDEWAYS_PAWNS | CHESSCAT_RULE_KANGAROO_PAWNS | CHESSCAT_RULE_TORPEDO_PAWNS, 5, 3070602},
+    {"sideways pawns, position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", CHESSCAT_RULE_SIDEWAYS_PAWNS, 3, 21140},
+    {"capture own", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", CHESSCAT_RULE_SIDEWAYS_PAWNS | CHESSCAT_RULE_CAPTURE_OWN, 3, 59028},
+    {"capture own, kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", CHESSCAT_RULE_CAPTURE_OWN, 3, 263672},
+    {"10x8 board", "rnbqkbnrbn/pppppppppp/10/10/10/10/PPPPPPPPPP/RNBQKBNRBN w - - 0 1", 0, 4, 481994},
+    {"four colors", NULL, 0, 5, 19550442},
+    {"four colors, pawn variants", NULL, CHESSCAT_RULE_SIDEWAYS_PAWNS | CHESSCAT_RULE_TORPEDO_PAWNS, 5, 29679752},
+};
+
+typedef struct
+{
+    chesscat_PackedMove moves[MAX_SPLIT_DEPTH]; // Moves from the root position to the subtree
+    uint64_t nodes; // Written only by the worker that counted it
+} Subtree;
+
+typedef struct
+{
+    // A worker's queue is a range of subtree indices. The owner takes from the back, thieves take from the front
+    pthread_mutex_t lock;
+    uint32_t front;
+    uint32_t back;
+} WorkQueue;
+
+typedef struct ParallelPerft ParallelPerft;
+
+typedef struct
+{
+    pthread_t thread;
+    uint16_t index;
+    WorkQueue queue;
+    chesscat_Position position; // Own copy, reset from the root for each subtree
+    chesscat_PackedMove *move_stack; // Own move buffers, subtree_depth plies of chesscat_get_max_moves moves
+    uint64_t nodes;
+    uint32_t num_subtrees;
+    uint32_t num_stolen;
+    chesscat_TTStats tt_stats; // This worker's own, added up once it has finished
+    ParallelPerft *perft;
+} Worker;
+
+struct ParallelPerft
+{
+    chesscat_Position *root;
+    uint8_t split_depth;
+    uint8_t subtree_depth; // Depth counted below each subtree
+    Subtree *subtrees;
+    uint32_t num_subtrees;
+    uint32_t max_subtrees;
+    Worker *workers;
+    uint16_t num_workers;
+    chesscat_TranspositionTable *tt;
+};
+
+double Seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void PrintMove(chesscat_PackedMove move)
+{
+    const char promotion_chars[CHESSCAT_NUM_PIECE_TYPES] = {'\0', 'p', 'k', 'q', 'r', 'n', 'b'};
+    chesscat_Move unpacked = chesscat_unpack_move(move);
+    printf("%c%d%c%d", 'a' + unpacked.from.col, unpacked.from.row + 1, 'a' + unpacked.to.col, unpacked.to.row + 1);
+    if (chesscat_packed_move_promotion(move) != Empty)
+    {
+        printf("%c", promotion_chars[chesscat_packed_move_promotion(move)]);
+    }
+}
+
+uint64_t Divide(chesscat_Position *position, uint8_t depth, chesscat_TranspositionTable *tt, chesscat_TTStats *tt_stats)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    uint16_t max_moves = chesscat_get_max_moves(&(position->game_rules));
+    chesscat_PackedMove *moves = malloc(max_moves * sizeof(chesscat_PackedMove));
+    if (moves == NULL)
+    {
+        printf("Out of memory\n");
+        return 0;
+    }
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, moves, max_moves);
+    uint64_t nodes = 0;
+    for (uint16_t i = 0; i < num_moves; i++)
+    {
+        chesscat_MoveUndo undo;
+        chesscat_do_move(position, moves[i], &undo);
+        uint64_t move_nodes = chesscat_perft(position, depth - 1, tt, tt_stats, NULL);
+        chesscat_undo_move(position, &undo);
+        PrintMove(moves[i]);
+        printf(": %llu\n", (unsigned long long)move_nodes);
+        nodes += move_nodes;
+    }
+    free(moves);
+    printf("\nMoves: %u\n", num_moves);
+    return nodes;
+}
+
+// Adds every line of split_depth legal moves from the root as a subtree. Lines ending early in mate or stalemate have no leaves.
+// Returns false if memory ran out
+bool CollectSubtrees(ParallelPerft *perft, chesscat_Position *position, chesscat_PackedMove line[], uint8_t ply)
+{
+    if (ply == perft->split_depth)
+    {
+        if (perft->num_subtrees == perft->max_subtrees)
+        {
+            uint32_t max_subtrees = perft->max_subtrees * 2 + 64;
+            Subtree *subtrees = realloc(perft->subtrees, max_subtrees * sizeof(Subtree));
+            if (subtrees == NULL)
+            {
+                return false;
+            }
+            perft->subtrees = subtrees;
+            perft->max_subtrees = max_subtrees;
+        }
+        Subtree *subtree = &(perft->subtrees[perft->num_subtrees++]);
+        memcpy(subtree->moves, line, ply * sizeof(chesscat_PackedMove));
+        subtree->nodes = 0;
+        return true;
+    }
+    uint16_t max_moves = chesscat_get_max_moves(&(position->game_rules));
+    chesscat_PackedMove *moves = malloc(max_moves * sizeof(chesscat_PackedMove));
+    if (moves == NULL)
+    {
+        return false;
+    }
+    uint16_t num_moves = chesscat_generate_legal_moves(position, GenerateAll, moves, max_moves);
+    bool collected = true;
+    for (uint16_t i = 0; i < num_moves && collected; i++)
+    {
+        chesscat_MoveUndo undo;
+        line[ply] = moves[i];
+        chesscat_do_move(position, moves[i], &undo);
+        collected = CollectSubtrees(perft, position, line, ply + 1);
+        chesscat_undo_move(position, &undo);
+    }
+    free(moves);
+    return collected;
+}
+
+// Takes a subtree index from the worker's own queue, or steals one from another worker's. Returns false when all are taken
+bool TakeSubtree(Worker *worker, uint32_t *subtree)
+{
+    ParallelPerft *perft = worker->perft;
+    bool found = false;
+    pthread_mutex_lock(&(worker->queue.lock));
+    if (worker->queue.front < worker->queue.back)
+    {
+        *subtree = --worker->queue.back;
+        found = true;
+    }
+    pthread_mutex_unlock(&(worker->queue.lock));
+    for (uint16_t i = 1; i < perft->num_workers && !found; i++)
+    {
+        WorkQueue *victim = &(perft->workers[(worker->index + i) % perft->num_workers].queue);
+        pthread_mutex_lock(&(victim->lock));
+        if (victim->front < victim->back)
+        {
+            *subtree = victim->front++;
+            found = true;
+            worker->num_stolen++;
+        }
+        pthread_mutex_unlock(&(victim->lock));
+    }
+    return found;
+}
+
+void *RunWorker(void *arg)
+{
+    Worker *worker = arg;
+    ParallelPerft *perft = worker->perft;
+    uint32_t index;
+    while (TakeSubtree(worker, &index))
+    {
+        Subtree *subtree = &(perft->subtrees[index]);
+        worker->position = *(perft->root);
+        for (uint8_t ply = 0; ply < perft->split_depth; ply++)
+        {
+            chesscat_MoveUndo undo;
+            chesscat_do_move(&(worker->position), subtree->moves[ply], &undo);
+        }
+        subtree->nodes = chesscat_perft(&(worker->position), perft->subtree_depth, perft->tt, &(worker->tt_stats), worker->move_stack);
+        worker->nodes += subtree->nodes;
+        worker->num_subtrees++;
+    }
+    return NULL;
+}
+
+/*
+ * ParallelCount
+ *
+ * Counts perft leaves with num_threads workers. The tree is split split_depth moves deep into subtrees, which are dealt
+ * out to the workers in equal runs; a worker that runs out steals from the others. Adds the workers' probes of tt to
+ * tt_stats. With divide set, prints the count below each root move, and with verbose set, each worker's share.
+ * Counts on the calling thread alone if the tree is too shallow to split or memory for splitting runs out
+ */
+uint64_t ParallelCount(chesscat_Position *root, uint8_t depth, uint8_t split_depth, uint16_t num_threads, chesscat_TranspositionTable *tt, chesscat_TTStats *tt_stats, bool divide, bool verbose)
+{
+    if (depth <= 1 || split_depth == 0)
+    {
+        return divide ? Divide(root, depth, tt, tt_stats) : chesscat_perft(root, depth, tt, tt_stats, NULL);
+    }
+    if (split_depth >= depth)
+    {
+        split_depth = depth - 1;
+    }
+    if (split_depth > MAX_SPLIT_DEPTH)
+    {
+        split_depth = MAX_SPLIT_DEPTH;
+    }
+    ParallelPerft perft = {.root = root, .split_depth = split_depth, .subtree_depth = depth - split_depth, .subtrees = NULL,
+                           .num_subtrees = 0, .max_subtrees = 0, .num_workers = num_threads, .tt = tt};
+    chesscat_PackedMove line[MAX_SPLIT_DEPTH];
+    size_t stack_size = (size_t)perft.subtree_depth * chesscat_get_max_moves(&(root->game_rules)) * sizeof(chesscat_PackedMove);
+    bool allocated = CollectSubtrees(&perft, root, line, 0);
+    perft.workers = allocated ? calloc(num_threads, sizeof(Worker)) : NULL;
+    for (uint16_t i = 0; i < num_threads && perft.workers != NULL; i++)
+    {
+        perft.workers[i].move_stack = malloc(stack_size);
+        allocated = allocated && perft.workers[i].move_stack != NULL;
+    }
+    if (!allocated || perft.workers == NULL)
+    {
+        for (uint16_t i = 0; i < num_threads && perft.workers != NULL; i++)
+        {
+            free(perft.workers[i].move_stack);
+        }
+        free(perft.workers);
+        free(perft.subtrees);
+        printf("Not enough memory to split the tree, counting on one thread\n");
+        return divide ? Divide(root, depth, tt, tt_stats) : chesscat_perft(root, depth, tt, tt_stats, NULL);
+    }
+
+    for (uint16_t i = 0; i < num_threads; i++)
+    {
+        Worker *worker = &(perft.workers[i]);
+        worker->index = i;
+        worker->perft = &perft;
+        worker->nodes = 0;
+        worker->num_subtrees = 0;
+        worker->num_stolen = 0;
+        worker->tt_stats.probes = 0;
+        worker->tt_stats.hits = 0;
+        worker->queue.front = (uint64_t)perft.num_subtrees * i / num_threads;
+        worker->queue.back = (uint64_t)perft.num_subtrees * (i + 1) / num_threads;
+        pthread_mutex_init(&(worker->queue.lock), NULL);
+    }
+    bool *started = calloc(num_threads, sizeof(bool));
+    uint16_t num_started = 0;
+    for (uint16_t i = 0; i < num_threads && started != NULL; i++)
+    {
+        started[i] = pthread_create(&(perft.workers[i].thread), NULL, RunWorker, &(perft.workers[i])) == 0;
+        num_started += started[i];
+    }
+    if (num_started == 0)
+    { // The first worker steals every subtree from the others
+        RunWorker(&(perft.workers[0]));
+    }
+    uint64_t nodes = 0;
+    for (uint16_t i = 0; i < num_threads; i++)
+    {
+        Worker *worker = &(perft.workers[i]);
+        if (started != NULL && started[i])
+        {
+            pthread_join(worker->thread, NULL);
+        }
+        pthread_mutex_destroy(&(worker->queue.lock));
+        free(worker->move_stack);
+        nodes += worker->nodes;
+        tt_stats->probes += worker->tt_stats.probes;
+        tt_stats->hits += worker->tt_stats.hits;
+    }
+    free(started);
+
+    if (divide)
+    {
+        uint16_t num_root_moves = 0;
+        for (uint32_t i = 0; i < perft.num_subtrees;)
+        {
+            uint64_t move_nodes = 0;
+            uint32_t j = i;
+            for (; j < perft.num_subtrees && perft.subtrees[j].moves[0] == perft.subtrees[i].moves[0]; j++)
+            {
+                move_nodes += perft.subtrees[j].nodes;
+            }
+            PrintMove(perft.subtrees[i].moves[0]);
+            printf(": %llu\n", (unsigned long long)move_nodes);
+            num_root_moves++;
+            i = j;
+        }
+        printf("\nMoves: %u\n", num_root_moves);
+    }
+    if (verbose)
+    {
+        printf("Subtrees: %u at depth %u\n", perft.num_subtrees, split_depth);
+        for (uint16_t i = 0; i < num_threads; i++)
+        {
+            Worker *worker = &(perft.workers[i]);
+            printf("Thread %u: %llu nodes, %u subtrees (%u stolen)\n", i, (unsigned long long)worker->nodes, worker->num_subtrees, worker->num_stolen);
+        }
+    }
+    free(perft.workers);
+    free(perft.subtrees);
+    return nodes;
+}
+
+void PrintSpeed(uint64_t nodes, double time)
+{
+    printf("Nodes: %llu\n", (unsigned long long)nodes);
+    printf("Time: %.3f s\n", time);
+    printf("Nodes/second: %.0f\n", time > 0 ? nodes / time : 0);
+}
+
+int RunSuite(bool use_mailbox, bool brute_force, chesscat_TranspositionTable *tt, chesscat_TTStats *tt_stats, uint16_t num_threads, uint8_t split_depth)
+{
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+    uint16_t num_failed = 0;
+    for (uint16_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++)
+    {
+        chesscat_Game game;
+        if (suite[i].fen == NULL)
+        {
+            chesscat_set_four_color_game(&game);
+        }
+        else if (chesscat_set_game_to_FEN(&game, (char *)suite[i].fen) != 0)
+        {
+            printf("%-28s invalid FEN\n", suite[i].name);
+            num_failed++;
+            continue;
+        }
+        chesscat_set_variant_rules(&(game.position), suite[i].rules); // Rules are part of the hash, so one table serves every position
+        game.position.game_rules.use_mailbox = use_mailbox;
+        double start = Seconds();
+        uint64_t nodes = num_threads > 1 ? ParallelCount(&(game.position), suite[i].depth, split_depth, num_threads, tt, tt_stats, false, false)
+                                         : chesscat_perft(&(game.position), suite[i].depth, tt, tt_stats, NULL);
+        double time = Seconds() - start;
+        bool passed = nodes == suite[i].nodes;
+        printf("%-28s depth %u  %12llu  %8.3f s  %s\n", suite[i].name, suite[i].depth, (unsigned long long)nodes, time, passed ? "ok" : "FAILED");
+        if (!passed)
+        {
+            printf("%-28s expected %llu\n", "", (unsigned long long)suite[i].nodes);
+            num_failed++;
+        }
+        if (brute_force)
+        {
+            uint64_t brute_nodes = chesscat_perft_brute_force(&(game.position), suite[i].depth);
+            printf("%-28s brute force  %12llu  %s\n", "", (unsigned long long)brute_nodes, brute_nodes == suite[i].nodes ? "ok" : "FAILED");
+            num_failed += brute_nodes != suite[i].nodes;
+        }
+        total_nodes += nodes;
+        total_time += time;
+    }
+    printf("\n");
+    PrintSpeed(total_nodes, total_time);
+    printf("Failed: %u\n", num_failed);
+    return num_failed != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool divide = false;
+    bool run_suite = false;
+    bool use_mailbox = false;
+    bool brute_force = false;
+    size_t tt_size = 0;
+    uint16_t num_threads = 1;
+    uint8_t split_depth = DEFAULT_SPLIT_DEPTH;
+    uint8_t rules = 0;
+    int depth = -1;
+    char *fen = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+        {
+            divide = true;
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            run_suite = true;
+        }
+        else if (strcmp(argv[i], "-m") == 0)
+        {
+            use_mailbox = true;
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            brute_force = true;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            tt_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+        {
+            split_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sideways") == 0)
+        {
+            rules |= CHESSCAT_RULE_SIDEWAYS_PAWNS;
+        }
+        else if (strcmp(argv[i], "--kangaroo") == 0)
+        {
+            rules |= CHESSCAT_RULE_KANGAROO_PAWNS;
+        }
+        else if (strcmp(argv[i], "--torpedo") == 0)
+        {
+            rules |= CHESSCAT_RULE_TORPEDO_PAWNS;
+        }
+        else if (strcmp(argv[i], "--capture-own") == 0)
+        {
+            rules |= CHESSCAT_RULE_CAPTURE_OWN;
+        }
+        else if (depth < 0)
+        {
+            depth = atoi(argv[i]);
+        }
+        else
+        {
+            fen = argv[i];
+        }
+    }
+    if ((!run_suite && (depth < 0 || depth > 255)) || num_threads == 0)
+    {
+        printf("Usage: perft [-d] [-s] [-m] [-b] [-t MB] [-j threads] [-p split depth] [--sideways] [--kangaroo] [--torpedo] [--capture-own] <depth> [FEN]\n");
+        return 1;
+    }
+
+    chesscat_TranspositionTable table;
+    chesscat_TranspositionTable *tt = NULL;
+    chesscat_TTStats tt_stats = {0, 0};
+    if (tt_size > 0)
+    {
+        if (!chesscat_tt_init(&table, tt_size, true))
+        {
+            printf("Could not allocate the transposition table\n");
+            return 1;
+        }
+        tt = &table;
+    }
+
+    int result = 0;
+    if (run_suite)
+    {
+        result = RunSuite(use_mailbox, brute_force, tt, &tt_stats, num_threads, split_depth);
+    }
+    else
+    {
+        chesscat_Game game;
+        if (fen == NULL)
+        {
+            chesscat_set_default_game(&game);
+        }
+        else if (chesscat_set_game_to_FEN(&game, fen) != 0)
+        {
+            printf("Invalid FEN\n");
+            return 1;
+        }
+        chesscat_set_variant_rules(&(game.position), rules);
+        game.position.game_rules.use_mailbox = use_mailbox;
+
+        double start = Seconds();
+        uint64_t nodes;
+        if (num_threads > 1)
+        {
+            nodes = ParallelCount(&(game.position), depth, split_depth, num_threads, tt, &tt_stats, divide, true);
+        }
+        else
+        {
+            nodes = divide ? Divide(&(game.position), depth, tt, &tt_stats) : chesscat_perft(&(game.position), depth, tt, &tt_stats, NULL);
+        }
+        PrintSpeed(nodes, Seconds() - start);
+        if (brute_force)
+        {
+            uint64_t brute_nodes = chesscat_perft_brute_force(&(game.position), depth);
+            printf("Brute force: %llu, %s\n", (unsigned long long)brute_nodes, brute_nodes == nodes ? "agrees" : "DIFFERS");
+            result = brute_nodes != nodes;
+        }
+    }
+
+    if (tt != NULL)
+    {
+        printf("Hash hit rate: %.1f%%, fill: %u/1000\n", chesscat_tt_hit_rate(&tt_stats) * 100, chesscat_tt_fill_permille(tt));
+        chesscat_tt_free(tt);
+    }
+    return result;
+}
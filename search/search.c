@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../libchesscat.h"
+
+/*
+ * Search driver and tactics suite.
+ *
+ * Usage: search [options] [FEN]
+ *   -d <depth>  Deepest iteration to search
+ *   -n <nodes>  Stop after this many nodes
+ *   -l <ms>     Stop after this many milliseconds
+ *   -t <MB>     Transposition table size (default 16, 0 for none)
+ *   -j <N>      Search with N threads sharing the table
+ *   -s          Run the tactics suite instead of a single position
+ *   -a <name>   Use a multi-player search: paranoid, maxn or brs (best reply)
+ *   -w <file>   Evaluate with the network in this weights file instead of material
+ *   --four      Search the four-color starting position instead of a FEN
+ *   --sideways, --kangaroo, --torpedo, --capture-own
+ *               Turn on variant rules for a single position
+ * With no limits given, a single position is searched to depth 6
+ */
+
+#define DEFAULT_DEPTH 6
+#define DEFAULT_TT_SIZE 16
+
+#define TWO_PLAYER -1 // Use chesscat_search rather than a multi-player algorithm
+
+typedef struct
+{
+    const char *name;
+    const char *fen; // NULL for the four-color starting position
+    uint8_t rules; // CHESSCAT_RULE_ flags
+    int8_t algorithm; // chesscat_EMultiPlayerAlgorithm, or TWO_PLAYER
+    uint8_t depth;
+    const char *best_move; // Expected first move of the principal variation, or several equally good ones separated by spaces
+} SuitePosition;
+
+static const SuitePosition suite[] = {
+    {"back rank mate", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 0, TWO_PLAYER, 4, "a1a8"},
+    {"scholar's mate", "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 0 1", 0, TWO_PLAYER, 4, "h5f7"},
+    {"rook mate in 2", "k7/8/2K5/8/8/8/8/7R w - - 0 1", 0, TWO_PLAYER, 4, "c6c7 c6b6"},
+    {"hanging queen", "4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 0, TWO_PLAYER, 4, "d1d5"},
+    {"knight fork", "r3k3/8/8/1N6/8/8/8/4K3 w - - 0 1", 0, TWO_PLAYER, 4, "b5c7"},
+    {"promotion", "8/4P1k1/8/8/8/8/8/K7 w - - 0 1", 0, TWO_PLAYER, 4, "e7e8q"},
+    {"sideways capture", "4r1k1/8/8/8/8/8/3Pq3/4K3 w - - 0 1", CHESSCAT_RULE_SIDEWAYS_PAWNS, TWO_PLAYER, 4, "d2e2"},
+    {"torpedo promotion", "6k1/8/P7/8/8/8/8/K7 w - - 0 1", CHESSCAT_RULE_TORPEDO_PAWNS, TWO_PLAYER, 2, "a6a8q"},
+    {"10x8 board", "rnbqkbnrbn/pppppppppp/10/10/10/10/PPPPPPPPPP/RNBQKBNRBN w - - 0 1", 0, TWO_PLAYER, 5, NULL},
+    {"paranoid queen", "4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 0, Paranoid, 4, "d1d5"},
+    {"max^n queen", "4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 0, MaxN, 4, "d1d5"},
+    {"best reply queen", "4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 0, BestReply, 4, "d1d5"},
+    {"paranoid mate", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 0, Paranoid, 3, "a1a8"},
+    {"four colors paranoid", NULL, 0, Paranoid, 4, NULL},
+    {"four colors max^n", NULL, 0, MaxN, 4, NULL},
+    {"four colors best reply", NULL, 0, BestReply, 4, NULL},
+};
+
+bool Search(chesscat_Position *position, chesscat_TranspositionTable *tt, int8_t algorithm, chesscat_SearchLimits *limits, chesscat_SearchResult *result)
+{
+    if (algorithm == TWO_PLAYER)
+    {
+        return chesscat_search(position, tt, limits, result);
+    }
+    return chesscat_search_multi(position, tt, algorithm, limits, result);
+}
+
+// Writes a move in coordinate notation, such as e2e4 or e7e8q
+void FormatMove(chesscat_PackedMove move, char *str)
+{
+    const char promotion_chars[CHESSCAT_NUM_PIECE_TYPES] = {'\0', 'p', 'k', 'q', 'r', 'n', 'b'};
+    chesscat_Move unpacked = chesscat_unpack_move(move);
+    int length = sprintf(str, "%c%d%c%d", 'a' + unpacked.from.col, unpacked.from.row + 1, 'a' + unpacked.to.col, unpacked.to.row + 1);
+    str[length] = promotion_chars[chesscat_packed_move_promotion(move)];
+    str[length + 1] = '\0';
+}
+
+void PrintResult(chesscat_SearchResult *result, int8_t algorithm)
+{
+    char move[8];
+    printf("Depth: %u\n", result->depth);
+    if (algorithm != TWO_PLAYER)
+    {
+        printf("Scores: white %d, red %d, black %d, green %d\n", result->scores[White], result->scores[Red], result->scores[Black], result->scores[Green]);
+    }
+    else if (result->score >= CHESSCAT_MATE_BOUND || result->score <= -CHESSCAT_MATE_BOUND)
+    {
+        int16_t plies = CHESSCAT_MATE_SCORE - abs(result->score);
+        printf("Score: mate in %d%s\n", (plies + 1) / 2, result->score < 0 ? " against" : "");
+    }
+    else
+    {
+        printf("Score: %d\n", result->score);
+    }
+    printf("PV:");
+    for (uint8_t i = 0; i < result->pv_length; i++)
+    {
+        FormatMove(result->pv[i], move);
+        printf(" %s", move);
+    }
+    printf("\n");
+    printf("Nodes: %llu\n", (unsigned long long)result->nodes);
+    printf("Time: %.3f s\n", result->seconds);
+    printf("Nodes/second: %.0f\n", result->seconds > 0 ? result->nodes / result->seconds : 0);
+    printf("Hash hits: %.1f%% of %llu probes\n", result->tt_probes > 0 ? 100.0 * result->tt_hits / result->tt_probes : 0, (unsigned long long)result->tt_probes);
+    printf("Pawn table hits: %.1f%% of %llu probes\n", result->pawn_probes > 0 ? 100.0 * result->pawn_hits / result->pawn_probes : 0, (unsigned long long)result->pawn_probes);
+    printf("Eval cache hits: %.1f%% of %llu probes\n", result->eval_probes > 0 ? 100.0 * result->eval_hits / result->eval_probes : 0, (unsigned long long)result->eval_probes);
+    printf("First-move cutoffs: %.1f%% of %llu cutoffs\n", result->cutoffs > 0 ? 100.0 * result->first_move_cutoffs / result->cutoffs : 0, (unsigned long long)result->cutoffs);
+    if (result->num_threads > 1)
+    {
+        for (uint16_t i = 0; i < result->num_threads; i++)
+        {
+            printf("Thread %u: %llu nodes, %.0f nodes/second\n", i, (unsigned long long)result->thread_nodes[i],
+                   result->seconds > 0 ? result->thread_nodes[i] / result->seconds : 0);
+        }
+    }
+}
+
+bool IsExpectedMove(const char *move, const char *expected)
+{
+    size_t length = strlen(move);
+    for (const char *start = expected; *start != '\0'; start += strcspn(start, " "), start += strspn(start, " "))
+    {
+        if (strncmp(start, move, length) == 0 && (start[length] == ' ' || start[length] == '\0'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int RunSuite(chesscat_TranspositionTable *tt, uint16_t num_threads)
+{
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+    uint16_t num_failed = 0;
+    for (uint16_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++)
+    {
+        chesscat_Game game;
+        if (suite[i].fen == NULL)
+        {
+            chesscat_set_four_color_game(&game);
+        }
+        else if (chesscat_set_game_to_FEN(&game, (char *)suite[i].fen) != 0)
+        {
+            printf("%-24s invalid FEN\n", suite[i].name);
+            num_failed++;
+            continue;
+        }
+        chesscat_set_variant_rules(&(game.position), suite[i].rules);
+        if (tt != NULL)
+        {
+            chesscat_tt_clear(tt);
+        }
+        chesscat_SearchLimits limits = {.depth = suite[i].depth, .num_threads = num_threads};
+        chesscat_SearchResult result;
+        if (!Search(&(game.position), tt, suite[i].algorithm, &limits, &result))
+        {
+            printf("%-24s could not allocate the search\n", suite[i].name);
+            num_failed++;
+            continue;
+        }
+        char move[8] = "none";
+        if (result.best_move != CHESSCAT_NO_MOVE)
+        {
+            FormatMove(result.best_move, move);
+        }
+        bool passed = suite[i].best_move == NULL ? result.best_move != CHESSCAT_NO_MOVE : IsExpectedMove(move, suite[i].best_move);
+        printf("%-24s depth %2u  %-6s %6d  %10llu  %7.3f s  %s\n", suite[i].name, result.depth, move, result.score,
+               (unsigned long long)result.nodes, result.seconds, passed ? "ok" : "FAILED");
+        if (!passed)
+        {
+            printf("%-24s expected %s\n", "", suite[i].best_move);
+            num_failed++;
+        }
+        total_nodes += result.nodes;
+        total_time += result.seconds;
+    }
+    printf("\n");
+    printf("Nodes: %llu\n", (unsigned long long)total_nodes);
+    printf("Nodes/second: %.0f\n", total_time > 0 ? total_nodes / total_time : 0);
+    printf("Failed: %u\n", num_failed);
+    return num_failed != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool run_suite = false;
+    chesscat_SearchLimits limits = {.depth = 0, .nodes = 0, .time_ms = 0, .num_threads = 1};
+    size_t tt_size = DEFAULT_TT_SIZE;
+    uint8_t rules = 0;
+    bool four_colors = false;
+    int8_t algorithm = TWO_PLAYER;
+    char *fen = NULL;
+    char *weights = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            limits.depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            limits.nodes = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            limits.time_ms = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            tt_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            limits.num_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            run_suite = true;
+        }
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && strcmp(argv[i + 1], "paranoid") == 0)
+        {
+            algorithm = Paranoid;
+            i++;
+        }
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && strcmp(argv[i + 1], "maxn") == 0)
+        {
+            algorithm = MaxN;
+            i++;
+        }
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && strcmp(argv[i + 1], "brs") == 0)
+        {
+            algorithm = BestReply;
+            i++;
+        }
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            weights = argv[++i];
+        }
+        else if (strcmp(argv[i], "--four") == 0)
+        {
+            four_colors = true;
+        }
+        else if (strcmp(argv[i], "--sideways") == 0)
+        {
+            rules |= CHESSCAT_RULE_SIDEWAYS_PAWNS;
+        }
+        else if (strcmp(argv[i], "--kangaroo") == 0)
+        {
+            rules |= CHESSCAT_RULE_KANGAROO_PAWNS;
+        }
+        else if (strcmp(argv[i], "--torpedo") == 0)
+        {
+            rules |= CHESSCAT_RULE_TORPEDO_PAWNS;
+        }
+        else if (strcmp(argv[i], "--capture-own") == 0)
+        {
+            rules |= CHESSCAT_RULE_CAPTURE_OWN;
+        }
+        else if (fen == NULL && argv[i][0] != '-')
+        {
+            fen = argv[i];
+        }
+        else
+        {
+            printf("Usage: search [-d depth] [-n nodes] [-l ms] [-t MB] [-j threads] [-s] [-a paranoid|maxn|brs] [-w weights] [--four] [--sideways] [--kangaroo] [--torpedo] [--capture-own] [FEN]\n");
+            return 1;
+        }
+    }
+    if (limits.depth == 0 && limits.nodes == 0 && limits.time_ms == 0)
+    {
+        limits.depth = DEFAULT_DEPTH;
+    }
+
+    if (weights != NULL && !chesscat_load_network(weights))
+    {
+        printf("Could not load %s\n", weights);
+        return 1;
+    }
+
+    chesscat_TranspositionTable table;
+    chesscat_TranspositionTable *tt = NULL;
+    if (tt_size > 0)
+    {
+        if (!chesscat_tt_init(&table, tt_size, true))
+        {
+            printf("Could not allocate the transposition table\n");
+            return 1;
+        }
+        tt = &table;
+    }
+
+    int status = 0;
+    if (run_suite)
+    {
+        status = RunSuite(tt, limits.num_threads);
+    }
+    else
+    {
+        chesscat_Game game;
+        if (four_colors)
+        {
+            chesscat_set_four_color_game(&game);
+        }
+        else if (fen == NULL)
+        {
+            chesscat_set_default_game(&game);
+        }
+        else if (chesscat_set_game_to_FEN(&game, fen) != 0)
+        {
+            printf("Invalid FEN\n");
+            return 1;
+        }
+        chesscat_set_variant_rules(&(game.position), rules);
+
+        chesscat_SearchResult result;
+        if (Search(&(game.position), tt, algorithm, &limits, &result))
+        {
+            PrintResult(&result, algorithm);
+        }
+        else
+        {
+            printf("Could not allocate the search\n");
+            status = 1;
+        }
+    }
+
+    if (tt != NULL)
+    {
+        chesscat_tt_free(tt);
+    }
+    chesscat_unload_network();
+    return status;
+}